@@ -1,3 +1,8 @@
 #!/bin/sh
-set -x
-exec gcc -std=c99 -Wall -Wextra -pedantic -Werror -g -O3 -march=native -Isrc -Iexample src/crocket.c example/crocket_test.c -o crocket_test
+set -e -x
+gcc -std=c99 -Wall -Wextra -pedantic -Werror -g -O3 -march=native -Isrc -Iexample src/crocket.c example/crocket_test.c -o crocket_test -pthread
+gcc -std=c99 -Wall -Wextra -pedantic -Werror -g -O3 -march=native -Isrc -Itools src/crocket.c tools/ctfopt.c -o ctfopt -pthread
+gcc -std=c99 -Wall -Wextra -pedantic -Werror -g -O3 -march=native -Isrc -Itools src/crocket.c tools/ctfexport.c -o ctfexport -pthread
+gcc -std=c99 -Wall -Wextra -pedantic -Werror -g -O3 -march=native -Isrc -Itools tools/shmdump.c -o shmdump
+gcc -std=c99 -Wall -Wextra -pedantic -Werror -g -O3 -march=native -Isrc -Itools src/crocket.c tools/crocket_server.c -o crocket_server -pthread
+gcc -std=c99 -Wall -Wextra -pedantic -Werror -g -O3 -march=native -Isrc -Itools tools/crocket_relay.c -o crocket_relay
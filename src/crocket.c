@@ -34,6 +34,8 @@
     #include <windows.h>
     #include <WinSock2.h>
     #include <ws2tcpip.h>
+    typedef HANDLE thread_t;
+    #define MEMORY_BARRIER() MemoryBarrier()
 #else
     #define _DEFAULT_SOURCE  // glibc: accept strdup
     #include <unistd.h>
@@ -43,10 +45,18 @@
     #include <netinet/in.h>
     #include <netdb.h>
     #include <time.h>
+    #include <pthread.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <errno.h>
     #define closesocket close
     typedef int SOCKET;
     #define INVALID_SOCKET (-1)
     #define SOCKET_ERROR (-1)
+    typedef pthread_t thread_t;
+    #define MEMORY_BARRIER() __sync_synchronize()
 #endif
 
 #include <stdio.h>
@@ -56,111 +66,1005 @@
 #include "crocket.h"
 
 #define var(s,n) float s;
+#define var3(s,n) float s[3];
+#define var4(s,n) float s[4];
 #include "crocket_vars.h"
 #undef var
-
-crocket_track_t crocket_tracks[] = {
-#define var(s,n) { &s, n, 0, 0, NULL },
+#undef var3
+#undef var4
+
+crocket_track_t crocket_static_tracks[] = {
+#define TRACK(p,n,vec,comp) { p, n, 0, 0, NULL, { { 0, 0.0f } }, CROCKET_TRACK_EMPTY, 0, 0, 0, vec, comp, 0, NULL, 0, 0, NULL, 0, 0 },
+#define var(s,n) TRACK(&s, n, 0, 0)
+#define var3(s,n) TRACK(&s[0], n ".x", 3, 0) TRACK(&s[1], n ".y", 0, 1) TRACK(&s[2], n ".z", 0, 2)
+#define var4(s,n) TRACK(&s[0], n ".x", 4, 0) TRACK(&s[1], n ".y", 0, 1) TRACK(&s[2], n ".z", 0, 2) TRACK(&s[3], n ".w", 0, 3)
 #include "crocket_vars.h"
 #undef var
+#undef var3
+#undef var4
+#undef TRACK
 { NULL, }
 };
 
-static const unsigned int ntracks = (sizeof(crocket_tracks) / sizeof(crocket_track_t)) - 1;
+//! all tracks: the ones from crocket_vars.h first, followed by the ones
+//! added with crocket_register_track(), terminated by an entry without name
+crocket_track_t* crocket_tracks = crocket_static_tracks;
+unsigned int crocket_ntracks = (sizeof(crocket_static_tracks) / sizeof(crocket_track_t)) - 1;  //!< number of tracks
+unsigned int crocket_tracks_alloc = 0;      //!< capacity of crocket_tracks if allocated dynamically
+unsigned int* crocket_name_index = NULL;    //!< hash table of track names (track index + 1, 0 = empty slot)
+unsigned int crocket_name_index_size = 0;   //!< number of slots in crocket_name_index (power of two)
+
+//! copy of the data that crocket_update() needs to sample a track, kept in
+//! an array parallel to crocket_tracks, so that sampling walks compact
+//! records instead of the complete tracks (see sample_tracks())
+typedef struct _hot_track {
+    float* p_var;               //!< the track's variable
+    const crocket_key_t* keys;  //!< the track's keys
+    unsigned int nkeys;         //!< the track's number of keys
+    unsigned int pos;           //!< key position found by the last update (see crocket_find_key())
+    unsigned char kind;         //!< CROCKET_TRACK_STEP to CROCKET_TRACK_GENERAL, or HOT_*
+} hot_track_t;
+
+hot_track_t* crocket_hot_tracks = NULL;     //!< sampling data of the tracks (parallel to crocket_tracks)
+unsigned int crocket_nhot = 0;              //!< number of tracks covered by crocket_hot_tracks
+unsigned int crocket_hot_alloc = 0;         //!< capacity of crocket_hot_tracks
+
+//! track group (all tracks whose names share the part before the first colon)
+typedef struct _group {
+    char* name;             //!< group name (without the colon; "" for tracks without a group)
+    int enabled;            //!< nonzero if the group's tracks are sampled in crocket_update()
+} group_t;
+
+//! range of consecutive tracks that belong to the same group
+typedef struct _group_run {
+    unsigned int start;     //!< index of the first track
+    unsigned int end;       //!< index after the last track
+    unsigned int group;     //!< index of the group
+} group_run_t;
+
+group_t* crocket_groups = NULL;             //!< all track groups
+unsigned int crocket_ngroups = 0;           //!< number of track groups
+unsigned int crocket_groups_alloc = 0;      //!< capacity of crocket_groups
+unsigned int* crocket_group_index = NULL;   //!< hash table of group names (group index + 1, 0 = empty slot)
+unsigned int crocket_group_index_size = 0;  //!< number of slots in crocket_group_index (power of two)
+group_run_t* crocket_runs = NULL;           //!< track ranges of the groups, in track order
+unsigned int crocket_nruns = 0;             //!< number of track ranges
+unsigned int crocket_runs_alloc = 0;        //!< capacity of crocket_runs
+unsigned int crocket_grouped_tracks = 0;    //!< number of tracks covered by crocket_runs
+int crocket_sampled_changed = 0;            //!< nonzero if crocket_update() samples new tracks (for lazy mode)
 
 int crocket_current_state = 0;              //!< current state/event bitmask
 float crocket_timescale = 1.0f;             //!< seconds-to-rows conversion factor
+unsigned int crocket_bake_rate = 0;         //!< baked table samples per row (0 = off)
+float crocket_bake_max_error = 0.0f;        //!< maximum error of baked tables
+int crocket_lazy_decode = 0;                //!< nonzero if track data is decoded on first use
+crocket_allocator_t crocket_allocator = { NULL, NULL, NULL };  //!< key memory allocation hooks
+int crocket_arena_mode = 0;                 //!< nonzero if key memory comes from the arena and pools
+crocket_key_t* crocket_arena = NULL;        //!< key arena for the track data loaded in crocket_init()
+unsigned int crocket_arena_size = 0;        //!< capacity of the key arena (in keys)
+unsigned int crocket_arena_used = 0;        //!< number of keys used in the key arena
+crocket_key_t* crocket_key_pools[12];       //!< free lists of pooled key arrays, by size class
+void* crocket_loaded_data = NULL;           //!< track data loaded from the save file (for lazy decoding)
+crocket_shared_values_t* crocket_shared = NULL;  //!< published shared memory segment
+size_t crocket_shared_size = 0;             //!< size of the shared memory segment
+char* crocket_shared_name = NULL;           //!< name of the shared memory segment
+#ifdef _WIN32
+HANDLE crocket_shared_handle = NULL;        //!< file mapping of the shared memory segment
+#endif
+int crocket_sync_role = CROCKET_SYNC_OFF;   //!< clock synchronization role
+SOCKET crocket_sync_socket = INVALID_SOCKET;  //!< clock synchronization UDP socket
+struct sockaddr_in crocket_sync_address;    //!< clock synchronization destination
+crocket_sync_stats_t crocket_sync_stats;    //!< clock synchronization statistics
 #ifndef CROCKET_PLAYER_ONLY
 char* crocket_save_file = NULL;             //!< save file name
 int crocket_mode = 0;                       //!< current mode (client/player)
 int crocket_current_row = -1;               //!< current row in editor
 SOCKET crocket_socket = INVALID_SOCKET;     //!< current connection socket
-struct sockaddr_in crocket_server_address;  //!< resolved server address
+struct sockaddr_storage crocket_server_address;  //!< resolved server address
+int crocket_server_address_len = 0;         //!< size of the server address
+crocket_shm_transport_t* crocket_shm = NULL;  //!< shared memory transport segment
+char* crocket_shm_name = NULL;              //!< shared memory transport segment name
+unsigned int crocket_shm_session = 0;       //!< shared memory transport session ID
+#ifdef _WIN32
+HANDLE crocket_shm_handle = NULL;           //!< file mapping of the shared memory transport
+#endif
+unsigned char crocket_rx_buffer[4096];      //!< received data that hasn't been processed yet
+int crocket_rx_size = 0;                    //!< number of bytes in the receive buffer
+int crocket_external_polling = 0;           //!< nonzero if the application waits for incoming data
+int crocket_lazy = 0;                       //!< nonzero if tracks are only requested when activated
+unsigned int* crocket_remote_map = NULL;    //!< track index for each server-side track index
+unsigned int crocket_nremote = 0;           //!< number of tracks requested from the server
+unsigned int crocket_remote_alloc = 0;      //!< capacity of crocket_remote_map
+int crocket_ctf_format = CROCKET_CTF_PLAIN; //!< CTF variant to produce
+float crocket_ctf_precision = 0.0f;         //!< compressed CTF quantization step
+crocket_track_t* crocket_shadow_tracks = NULL;  //!< keys received during a resync (parallel to crocket_tracks)
+unsigned int crocket_nshadow = 0;           //!< number of tracks covered by the current resync
+unsigned int crocket_shadow_alloc = 0;      //!< capacity of crocket_shadow_tracks
+int crocket_resync = 0;                     //!< nonzero while the server resends the keys after connecting
+double crocket_resync_time = 0.0;           //!< time of the last key data (or request) during a resync
+int crocket_hash_sync = 0;                  //!< nonzero if the hash sync extension shall be negotiated
+int crocket_hash_sync_state = 0;            //!< hash sync state of the current connection (HASH_SYNC_*)
 #endif // CROCKET_PLAYER_ONLY
 
-#define INITIAL_KEY_ALLOC 16  //!< keys to allocate initially for each track
+#define INITIAL_KEY_ALLOC 16u //!< keys to allocate when a track outgrows its inline keys
+#define KEY_POOL_CLASSES  12  //!< number of key pool size classes (INITIAL_KEY_ALLOC << n keys)
 #define RECONNECT_TIMEOUT 20  //!< reconnect timeout in milliseconds
-
+#define RESYNC_SETTLE_TIME 0.1  //!< time without new key data after which a resync is complete, in seconds
+#define HASH_SYNC_OFF     0     //!< hash sync state: plain protocol
+#define HASH_SYNC_PROBING 1     //!< hash sync state: looking for the server's advertisement after the greeting
+#define HASH_SYNC_ON      2     //!< hash sync state: tracks are requested with their hashes
+#define SHM_IO_TIMEOUT  1000  //!< shared memory transport I/O timeout in milliseconds
+#define HOT_STALE 0           //!< hot track class: copy needs to be updated from the track
+#define HOT_DONE  1           //!< hot track class: constant value has been written already
+#define HOT_FULL  5           //!< hot track class: sample from the complete track
+
+static void* read_file(const char* filename);
 static void load_data(const unsigned char* pos);
+static void decode_track(crocket_track_t* t);
+static void apply_attached_data(void);
+static void detach_all(void);
+
+
+///////////////////////////////////////////////////////////////////////////////
+///// PLATFORM SUPPORT                                                    /////
+///////////////////////////////////////////////////////////////////////////////
+
+//! get the time of a monotonic clock, in seconds
+static double get_monotonic_time(void) {
+#ifdef _WIN32
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return (double)t.QuadPart / (double)f.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1E-9 * (double)ts.tv_nsec;
+#endif
+}
+
+//! get the system name of a shared memory segment
+//! \returns the name, to be free()'d by the caller
+//! \note POSIX shared memory names must start with a slash; this is added
+//!       if necessary. On Windows, the name is used as-is.
+static char* shm_object_name(const char* name) {
+    char* res = malloc(strlen(name) + 2);
+    if (!res) { return NULL; }
+#ifdef _WIN32
+    strcpy(res, name);
+#else
+    res[0] = '/';
+    strcpy(&res[(name[0] == '/') ? 0 : 1], name);
+#endif
+    return res;
+}
+
+//! job function for run_parallel()
+//! \param index  number of the worker that runs the function
+//! \param count  total number of workers
+//! \param ctx    context pointer passed to run_parallel()
+typedef void (*parallel_job_t)(unsigned int index, unsigned int count, void* ctx);
+
+//! parameters of a single worker thread in run_parallel()
+typedef struct _worker {
+    parallel_job_t job;
+    unsigned int index;
+    unsigned int count;
+    void* ctx;
+} worker_t;
+
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg) {
+    worker_t* w = arg;
+    w->job(w->index, w->count, w->ctx);
+    return 0;
+}
+#else
+static void* worker_main(void* arg) {
+    worker_t* w = arg;
+    w->job(w->index, w->count, w->ctx);
+    return NULL;
+}
+#endif
+
+//! determine the number of CPU cores
+static unsigned int cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (si.dwNumberOfProcessors > 0) ? (unsigned int)si.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (unsigned int)n : 1;
+#endif
+}
+
+//! run a job on multiple threads (including the calling one) and wait
+//! until all of them are finished
+static void run_parallel(parallel_job_t job, unsigned int count, void* ctx) {
+    worker_t* workers;
+    thread_t* threads;
+    unsigned int i, started = 0;
+    if (count < 2) {
+        job(0, 1, ctx);
+        return;
+    }
+    workers = calloc(count, sizeof(worker_t));
+    threads = malloc(count * sizeof(thread_t));
+    if (!workers || !threads) {
+        free(workers);
+        free(threads);
+        job(0, 1, ctx);  // out of memory: fall back to single-threaded mode
+        return;
+    }
+    for (i = 0;  i < count;  ++i) {
+        workers[i].job = job;
+        workers[i].index = i;
+        workers[i].count = count;
+        workers[i].ctx = ctx;
+    }
+    // start workers 1...count-1 (and run any that couldn't be started here)
+    for (i = 1;  i < count;  ++i) {
+#ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, worker_main, &workers[i], 0, NULL);
+        if (threads[i]) { ++started; continue; }
+#else
+        if (!pthread_create(&threads[i], NULL, worker_main, &workers[i])) { ++started; continue; }
+#endif
+        break;
+    }
+    for (i = started + 1;  i < count;  ++i) {
+        worker_main(&workers[i]);
+    }
+    worker_main(&workers[0]);
+    for (i = 1;  i <= started;  ++i) {
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+    free(workers);
+    free(threads);
+}
+
+int crocket_ring_write(crocket_shm_ring_t* ring, const void* data, int bytes) {
+    unsigned int head = ring->head;
+    unsigned int space = CROCKET_SHM_RING_SIZE - (head - ring->tail);
+    unsigned int pos = head % CROCKET_SHM_RING_SIZE, n;
+    if (bytes <= 0) { return 0; }
+    if ((unsigned int)bytes > space) { bytes = (int)space; }
+    n = CROCKET_SHM_RING_SIZE - pos;
+    if (n > (unsigned int)bytes) { n = (unsigned int)bytes; }
+    MEMORY_BARRIER();  // don't overwrite data the consumer is still reading
+    memcpy(&ring->data[pos], data, n);
+    memcpy(ring->data, (const unsigned char*)data + n, bytes - n);
+    MEMORY_BARRIER();  // data must be visible before the new head
+    ring->head = head + bytes;
+    return bytes;
+}
+
+int crocket_ring_read(crocket_shm_ring_t* ring, void* data, int bytes) {
+    unsigned int tail = ring->tail;
+    unsigned int avail = ring->head - tail;
+    unsigned int pos = tail % CROCKET_SHM_RING_SIZE, n;
+    if (bytes <= 0) { return 0; }
+    if ((unsigned int)bytes > avail) { bytes = (int)avail; }
+    n = CROCKET_SHM_RING_SIZE - pos;
+    if (n > (unsigned int)bytes) { n = (unsigned int)bytes; }
+    MEMORY_BARRIER();  // don't read data older than the head
+    memcpy(data, &ring->data[pos], n);
+    memcpy((unsigned char*)data + n, ring->data, bytes - n);
+    MEMORY_BARRIER();  // data must be read before the producer may overwrite it
+    ring->tail = tail + bytes;
+    return bytes;
+}
 
 
 ///////////////////////////////////////////////////////////////////////////////
 ///// TRACK DATA ACCESS AND MANIPULATION                                  /////
 ///////////////////////////////////////////////////////////////////////////////
 
+void crocket_set_allocator(const crocket_allocator_t* allocator) {
+    if (allocator && allocator->alloc && allocator->free) {
+        crocket_allocator = *allocator;
+    }
+    else {
+        memset(&crocket_allocator, 0, sizeof(crocket_allocator));
+    }
+}
+
+void crocket_set_arena(int enable) {
+    crocket_arena_mode = enable;
+}
+
+//! allocate a key array with the allocation hooks
+static crocket_key_t* alloc_keys(unsigned int count) {
+    size_t size = count * sizeof(crocket_key_t);
+    if (!count) { return NULL; }
+    return crocket_allocator.alloc ? crocket_allocator.alloc(size, crocket_allocator.user) : malloc(size);
+}
+
+//! get the key pool size class of a key array capacity
+//! \returns the pool index, or -1 if the capacity doesn't belong to a pool
+static int key_pool_class(unsigned int count) {
+    int c;
+    for (c = 0;  c < KEY_POOL_CLASSES;  ++c) {
+        if (count == (INITIAL_KEY_ALLOC << c)) { return c; }
+    }
+    return -1;
+}
+
+#ifndef CROCKET_PLAYER_ONLY
+//! allocate a key array for a growing track, from a pool in arena mode
+//! \note must only be called from the main thread
+static crocket_key_t* alloc_pooled_keys(unsigned int count) {
+    int c = crocket_arena_mode ? key_pool_class(count) : -1;
+    crocket_key_t* keys;
+    if ((c < 0) || !crocket_key_pools[c]) { return alloc_keys(count); }
+    keys = crocket_key_pools[c];
+    memcpy(&crocket_key_pools[c], keys, sizeof(crocket_key_t*));  // pop from the free list
+    return keys;
+}
+#endif // CROCKET_PLAYER_ONLY
+
+
+//! free a key array
+//! \param keys   the array to free (if it's in the arena, nothing happens)
+//! \param alloc  capacity of the array, in keys
+static void free_keys(crocket_key_t* keys, unsigned int alloc) {
+    int c;
+    if (!keys || ((keys >= crocket_arena) && (keys < &crocket_arena[crocket_arena_size]))) {
+        return;
+    }
+    c = crocket_arena_mode ? key_pool_class(alloc) : -1;
+    if (c >= 0) {
+        // keep the array for reuse (the link is stored in the array itself)
+        memcpy(keys, &crocket_key_pools[c], sizeof(crocket_key_t*));
+        crocket_key_pools[c] = keys;
+    }
+    else if (crocket_allocator.free) {
+        crocket_allocator.free(keys, alloc * sizeof(crocket_key_t), crocket_allocator.user);
+    }
+    else {
+        free(keys);
+    }
+}
+
+//! check whether the keys of a track are stored in the track record itself
+//! \note Heap and arena key arrays are always larger than CROCKET_INLINE_KEYS.
+static inline int has_inline_keys(const crocket_track_t* t) {
+    return t->alloc && (t->alloc <= CROCKET_INLINE_KEYS);
+}
+
+//! free the keys of a track and make it empty
+static void free_track_keys(crocket_track_t* t) {
+    if (!has_inline_keys(t)) {
+        free_keys(t->keys, t->alloc);
+    }
+    t->keys = NULL;
+    t->nkeys = t->alloc = 0;
+}
+
+//! replace the keys of a track that's loaded from CTF data by 'count'
+//! uninitialized keys, stored inline if there are few enough of them, or in
+//! the arena if there's enough room left
+//! \returns the new keys, or NULL if count is zero or out of memory
+static crocket_key_t* alloc_loaded_keys(crocket_track_t* t, unsigned int count) {
+    free_track_keys(t);
+    if (!count) { return NULL; }
+    if (count <= CROCKET_INLINE_KEYS) {
+        t->keys = t->inline_keys;
+        t->alloc = CROCKET_INLINE_KEYS;
+    }
+    // (only tracks in the main track list have variables; tracks of
+    // standalone lists may be loaded on other threads)
+    else if (!t->p_var || !crocket_arena || ((crocket_arena_size - crocket_arena_used) < count)) {
+        t->keys = alloc_keys(count);
+        t->alloc = t->keys ? count : 0;
+    }
+    else {
+        t->keys = &crocket_arena[crocket_arena_used];
+        t->alloc = count;
+        crocket_arena_used += count;
+    }
+    t->nkeys = t->alloc ? count : 0;
+    return t->keys;
+}
+
+//! set up the key arena for a known number of keys
+static void reserve_arena(unsigned int count) {
+    if (!crocket_arena_mode || crocket_arena || !count) { return; }
+    crocket_arena = alloc_keys(count);
+    crocket_arena_size = crocket_arena ? count : 0;
+    crocket_arena_used = 0;
+}
+
+//! free the key arena and the key pools
+//! \note The arena must not be in use by any track any longer.
+static void free_key_memory(void) {
+    int c;
+    int arena_mode = crocket_arena_mode;
+    crocket_arena_mode = 0;  // really free, don't put back into the pools
+    for (c = 0;  c < KEY_POOL_CLASSES;  ++c) {
+        while (crocket_key_pools[c]) {
+            crocket_key_t* keys = crocket_key_pools[c];
+            memcpy(&crocket_key_pools[c], keys, sizeof(crocket_key_t*));
+            free_keys(keys, INITIAL_KEY_ALLOC << c);
+        }
+    }
+    if (crocket_arena) {
+        crocket_key_t* arena = crocket_arena;
+        crocket_arena = NULL;
+        free_keys(arena, crocket_arena_size);
+    }
+    crocket_arena_size = crocket_arena_used = 0;
+    crocket_arena_mode = arena_mode;
+}
+
+//! hash function for track names (FNV-1a)
+static unsigned int hash_name(const char* name, unsigned int len) {
+    unsigned int h = 2166136261u;
+    while (len--) {
+        h = (h ^ (unsigned char)(*name++)) * 16777619u;
+    }
+    return h;
+}
+
+//! (re)build the track name index with a specific number of slots
+//! \returns zero if out of memory
+static int build_name_index(unsigned int size) {
+    unsigned int* index = calloc(size, sizeof(unsigned int));
+    unsigned int i;
+    if (!index) { return 0; }
+    free(crocket_name_index);
+    crocket_name_index = index;
+    crocket_name_index_size = size;
+    for (i = 0;  i < crocket_ntracks;  ++i) {
+        const char* name = crocket_tracks[i].name;
+        unsigned int slot = hash_name(name, (unsigned int)strlen(name));
+        while (index[slot & (size - 1)]) { ++slot; }
+        index[slot & (size - 1)] = i + 1;
+    }
+    return 1;
+}
+
+//! find a track by its name
+static crocket_track_t* find_track_by_name(const char* name, unsigned int len) {
+    crocket_track_t* t;
+    unsigned int slot;
+    if (!crocket_name_index) {
+        unsigned int size = 64;
+        while (size < (crocket_ntracks * 2)) { size <<= 1; }
+        if (!build_name_index(size)) {
+            // out of memory: fall back to a linear search
+            for (t = crocket_tracks;  t->name;  ++t) {
+                if ((strlen(t->name) == len) && !memcmp(t->name, name, len)) { return t; }
+            }
+            return NULL;
+        }
+    }
+    for (slot = hash_name(name, len);  crocket_name_index[slot & (crocket_name_index_size - 1)];  ++slot) {
+        t = &crocket_tracks[crocket_name_index[slot & (crocket_name_index_size - 1)] - 1];
+        if (!strncmp(t->name, name, len) && !t->name[len]) { return t; }
+    }
+    return NULL;
+}
+
+//! free all track group information
+static void free_groups(void) {
+    unsigned int i;
+    for (i = 0;  i < crocket_ngroups;  ++i) {
+        free(crocket_groups[i].name);
+    }
+    free(crocket_groups);
+    free(crocket_runs);
+    free(crocket_group_index);
+    crocket_groups = NULL;
+    crocket_runs = NULL;
+    crocket_group_index = NULL;
+    crocket_ngroups = crocket_nruns = crocket_grouped_tracks = 0;
+    crocket_groups_alloc = crocket_runs_alloc = crocket_group_index_size = 0;
+    crocket_sampled_changed = 1;  // now all tracks are sampled
+}
+
+//! find a track group by its name
+//! \returns the group index, or crocket_ngroups if not found
+static unsigned int find_group(const char* name, size_t len) {
+    unsigned int slot;
+    if (!crocket_group_index) { return crocket_ngroups; }
+    for (slot = hash_name(name, (unsigned int)len);  crocket_group_index[slot & (crocket_group_index_size - 1)];  ++slot) {
+        unsigned int g = crocket_group_index[slot & (crocket_group_index_size - 1)] - 1;
+        if (!strncmp(crocket_groups[g].name, name, len) && !crocket_groups[g].name[len]) { return g; }
+    }
+    return crocket_ngroups;
+}
+
+//! add the last group to the group name index, growing the index if it
+//! gets too full
+//! \returns zero if out of memory
+static int index_new_group(void) {
+    unsigned int slot, g;
+    if ((crocket_ngroups * 2) > crocket_group_index_size) {
+        unsigned int size = crocket_group_index_size ? (crocket_group_index_size * 2) : 64;
+        unsigned int* index = calloc(size, sizeof(unsigned int));
+        if (!index) { return 0; }
+        free(crocket_group_index);
+        crocket_group_index = index;
+        crocket_group_index_size = size;
+        g = 0;  // re-add all groups
+    }
+    else {
+        g = crocket_ngroups - 1;
+    }
+    for (;  g < crocket_ngroups;  ++g) {
+        const char* name = crocket_groups[g].name;
+        for (slot = hash_name(name, (unsigned int)strlen(name));  crocket_group_index[slot & (crocket_group_index_size - 1)];  ++slot);
+        crocket_group_index[slot & (crocket_group_index_size - 1)] = g + 1;
+    }
+    return 1;
+}
+
+//! add the next track (index crocket_grouped_tracks) to the group information
+//! \returns zero if out of memory
+static int add_track_to_groups(void) {
+    const char* name = crocket_tracks[crocket_grouped_tracks].name;
+    const char* colon = strchr(name, ':');
+    size_t len = colon ? (size_t)(colon - name) : 0;
+    unsigned int g;
+
+    // find the track's group, create it if it doesn't exist yet
+    g = find_group(name, len);
+    if (g >= crocket_ngroups) {
+        char* group_name;
+        if (crocket_ngroups >= crocket_groups_alloc) {
+            unsigned int new_alloc = crocket_groups_alloc ? (crocket_groups_alloc << 1) : 16;
+            group_t* new_groups = realloc(crocket_groups, new_alloc * sizeof(group_t));
+            if (!new_groups) { return 0; }
+            crocket_groups = new_groups;
+            crocket_groups_alloc = new_alloc;
+        }
+        group_name = malloc(len + 1);
+        if (!group_name) { return 0; }
+        memcpy(group_name, name, len);
+        group_name[len] = '\0';
+        crocket_groups[g].name = group_name;
+        crocket_groups[g].enabled = 1;
+        ++crocket_ngroups;
+        if (!index_new_group()) { return 0; }
+    }
+
+    // extend the last range, or start a new one
+    if (crocket_nruns && (crocket_runs[crocket_nruns - 1].group == g)) {
+        crocket_runs[crocket_nruns - 1].end++;
+    }
+    else {
+        if (crocket_nruns >= crocket_runs_alloc) {
+            unsigned int new_alloc = crocket_runs_alloc ? (crocket_runs_alloc << 1) : 16;
+            group_run_t* new_runs = realloc(crocket_runs, new_alloc * sizeof(group_run_t));
+            if (!new_runs) { return 0; }
+            crocket_runs = new_runs;
+            crocket_runs_alloc = new_alloc;
+        }
+        crocket_runs[crocket_nruns].start = crocket_grouped_tracks;
+        crocket_runs[crocket_nruns].end = crocket_grouped_tracks + 1;
+        crocket_runs[crocket_nruns].group = g;
+        ++crocket_nruns;
+    }
+    ++crocket_grouped_tracks;
+    crocket_sampled_changed |= crocket_groups[g].enabled;
+    return 1;
+}
+
+//! compute the track groups from scratch (all groups enabled)
+static void build_groups(void) {
+    free_groups();
+    while (crocket_grouped_tracks < crocket_ntracks) {
+        if (!add_track_to_groups()) {
+            free_groups();  // out of memory: sample all tracks
+            return;
+        }
+    }
+}
+
+int crocket_find_group(const char* name) {
+    unsigned int g;
+    if (!name) { name = ""; }
+    g = find_group(name, strlen(name));
+    return (g < crocket_ngroups) ? (int)g : -1;
+}
+
+void crocket_enable_group(int group, int enable) {
+    if ((group >= 0) && ((unsigned int)group < crocket_ngroups)) {
+        crocket_groups[group].enabled = enable;
+        crocket_sampled_changed |= enable;
+    }
+}
+
+unsigned int crocket_enable_groups(const char* prefix, int enable) {
+    size_t len = prefix ? strlen(prefix) : 0;
+    unsigned int g, count = 0;
+    for (g = 0;  g < crocket_ngroups;  ++g) {
+        if (!len || !strncmp(crocket_groups[g].name, prefix, len)) {
+            crocket_groups[g].enabled = enable;
+            ++count;
+        }
+    }
+    if (count && enable) { crocket_sampled_changed = 1; }
+    return count;
+}
+
 const crocket_track_t* crocket_find_track(const float* p_var) {
-    const crocket_track_t* t;
+    crocket_track_t* t;
     for (t = crocket_tracks;  t->name;  ++t) {
         if (t->p_var == p_var) {
+            if (t->ctf_keys) { decode_track(t); }
             return t;
         }
     }
     return NULL;
 }
 
+const crocket_track_t* crocket_get_track(unsigned int index) {
+    crocket_track_t* t;
+    if (index >= crocket_ntracks) { return NULL; }
+    t = &crocket_tracks[index];
+    if (t->ctf_keys) { decode_track(t); }
+    return t;
+}
+
 unsigned int crocket_find_key(const crocket_track_t* t, unsigned int row) {
-    unsigned int a, b, c, pivot;
-    if (!t || !t->nkeys || (row < t->keys[0].row)) {
-        return 0;  // before first key
-    }
-    a = 0;
-    b = t->nkeys;
-    while ((a + 1) < b) {
-        c = (a + b) >> 1;
-        pivot = t->keys[c].row;
-        if (row == pivot) {
-            return c + 1;  // shortcut for exact hit
+    return crocket_find_key_inline(t, row);
+}
+
+// values of the track classes with keys, at a known key position
+// (as returned by crocket_find_key())
+static inline float step_value(const crocket_key_t* keys, unsigned int pos) {
+    return keys[pos ? (pos-1) : 0].value;
+}
+static inline float linear_value(const crocket_key_t* keys, unsigned int nkeys, unsigned int pos, float row) {
+    const crocket_key_t* k;
+    if (!pos) { return keys[0].value; }  // before first key
+    k = &keys[pos-1];
+    if ((pos >= nkeys) || (crocket_key_interpol(&k[0]) != 1)) { return k[0].value; }  // after last key, or step
+    return k[0].value + (row - (float)crocket_key_row(&k[0])) / (float)(crocket_key_row(&k[1]) - crocket_key_row(&k[0])) * (k[1].value - k[0].value);
+}
+static inline float general_value(const crocket_key_t* keys, unsigned int nkeys, unsigned int pos, float row) {
+    const crocket_key_t* k;
+    if (!pos) { return keys[0].value; }  // before first key
+    k = &keys[pos-1];
+    if ((pos >= nkeys) || !crocket_key_interpol(&k[0])) { return k[0].value; }  // after last key, or uninterpolated
+    return crocket_interpolate(k, row);
+}
+
+// specialized samplers for the track classes
+static float sample_empty(const crocket_track_t* t, float row) {
+    (void) t;
+    (void) row;
+    return 0.0f;
+}
+static float sample_constant(const crocket_track_t* t, float row) {
+    (void) row;
+    return t->keys[0].value;
+}
+static float sample_step(const crocket_track_t* t, float row) {
+    return step_value(t->keys, crocket_find_key_inline(t, (row <= 0.0f) ? 0 : (unsigned int)row));
+}
+static float sample_linear(const crocket_track_t* t, float row) {
+    return linear_value(t->keys, t->nkeys, crocket_find_key_inline(t, (row <= 0.0f) ? 0 : (unsigned int)row), row);
+}
+static float sample_general(const crocket_track_t* t, float row) {
+    return general_value(t->keys, t->nkeys, crocket_find_key_inline(t, (row <= 0.0f) ? 0 : (unsigned int)row), row);
+}
+
+static float sample_undecoded(const crocket_track_t* t, float row) {
+    decode_track((crocket_track_t*)t);  // changes the track's class
+    return crocket_sample(t, row);
+}
+
+static float sample_baked(const crocket_track_t* t, float row) {
+    const float* cell;
+    unsigned int i;
+    float x = (row - (float)t->table_start) * (float)crocket_bake_rate;
+    float x_max = (float)(t->table_size - 1);
+    x = (x < 0.0f) ? 0.0f : (x > x_max) ? x_max : x;
+    i = (unsigned int)x;
+    cell = &t->table[2 * i];
+    return cell[0] + (x - (float)i) * (cell[1] - cell[0]);
+}
+
+//! samplers for each track class (indexed by CROCKET_TRACK_*)
+static float (* const samplers[])(const crocket_track_t* t, float row) = {
+    sample_empty,
+    sample_constant,
+    sample_step,
+    sample_linear,
+    sample_general,
+    sample_baked,
+    sample_undecoded,
+};
+
+float crocket_sample(const crocket_track_t* t, float row) {
+    return t ? samplers[t->kind](t, row) : 0.0f;
+}
+
+//! check whether all components of a vector variable can be sampled together
+//! (i.e. their keys are at the same rows and have the same modes)
+static void check_shared_keys(crocket_track_t* v) {
+    const crocket_track_t* t;
+    unsigned int i;
+    v->shared_keys = 0;
+    for (t = &v[1];  t < &v[v->vector];  ++t) {
+        if (v->ctf_keys || t->ctf_keys || (t->nkeys != v->nkeys)) { return; }
+        // (the last key's interpolation mode doesn't matter)
+        for (i = 0;  i < t->nkeys;  ++i) {
+            if ((crocket_key_row(&t->keys[i]) != crocket_key_row(&v->keys[i]))
+            || (((i + 1) < t->nkeys) && (t->keys[i].row_mode != v->keys[i].row_mode))) {
+                return;
+            }
         }
-        if (row > pivot) { a = c; }
-                    else { b = c; }
     }
-    return a + 1;
+    v->shared_keys = 1;
 }
 
-float crocket_sample(const crocket_track_t* t, float row) {
-    const crocket_key_t* k;
-    unsigned int pos;
+//! check whether a vector variable can currently be sampled together
+static inline int is_vector_shared(const crocket_track_t* v) {
+    const crocket_track_t* t;
+    if (!v->shared_keys) { return 0; }
+    for (t = v;  t < &v[v->vector];  ++t) {
+        if ((t->kind > CROCKET_TRACK_GENERAL) || t->bake_pending) { return 0; }
+    }
+    return 1;
+}
+
+//! sample all components of a vector variable with shared keys
+//! \note The results are identical to sampling each component on its own.
+static void sample_shared_vector(const crocket_track_t* v, float row, float* values) {
+    unsigned int c, pos;
     float x;
-    if (!t || !t->nkeys) { return 0.0f; }  // empty track
-    pos = crocket_find_key(t, (row <= 0.0f) ? 0 : (unsigned int)row);
-    if (!pos) { return t->keys[0].value; }  // before first key
-    k = &t->keys[pos-1];
-    if ((pos >= t->nkeys) || !k[0].interpol) { return k[0].value; }  // after last key, or uninterpolated
-    x = (row - (float)k[0].row) / (float)(k[1].row - k[0].row);
-    switch (k[0].interpol) {
-        case 1:  /* linear */     break;
-        case 2:  /* smoothstep */ x *= x * (3.0f - 2.0f * x);  break;
-        case 3:  /* ramp-up */    x *= x; break;
-        default: /* unknown */    x = 0.0f; break;
+    if (!v->nkeys) {
+        for (c = 0;  c < v->vector;  ++c) { values[c] = 0.0f; }
+        return;
+    }
+    pos = crocket_find_key_inline(v, (row <= 0.0f) ? 0 : (unsigned int)row);
+    if (!pos || (pos >= v->nkeys) || !crocket_key_interpol(&v->keys[pos-1])) {
+        // before first key, after last key, or uninterpolated
+        pos = pos ? (pos - 1) : 0;
+        for (c = 0;  c < v->vector;  ++c) { values[c] = v[c].keys[pos].value; }
+        return;
+    }
+    x = crocket_interpolation_factor(&v->keys[pos-1], row);
+    for (c = 0;  c < v->vector;  ++c) {
+        const crocket_key_t* k = &v[c].keys[pos-1];
+        values[c] = k[0].value + x * (k[1].value - k[0].value);
+    }
+}
+
+unsigned int crocket_sample_vector(const crocket_track_t* t, float row, float* values) {
+    unsigned int c;
+    if (!t) { return 0; }
+    if (!t->vector) {
+        values[0] = crocket_sample(t, row);
+        return 1;
+    }
+    if (is_vector_shared(t)) {
+        sample_shared_vector(t, row, values);
+    }
+    else {
+        for (c = 0;  c < t->vector;  ++c) { values[c] = crocket_sample(&t[c], row); }
+    }
+    return t->vector;
+}
+
+//! make sample_tracks() update its copy of a track's data
+//! (only tracks in the main track list have variables; tracks of standalone
+//! lists may be classified on other threads)
+static inline void invalidate_hot_track(const crocket_track_t* t) {
+    if (t->p_var && (t >= crocket_tracks) && (t < &crocket_tracks[crocket_nhot])) {
+        crocket_hot_tracks[t - crocket_tracks].kind = HOT_STALE;
+    }
+}
+
+void crocket_classify_track(crocket_track_t* t) {
+    const crocket_key_t* k;
+    unsigned char kind = CROCKET_TRACK_CONSTANT;
+    int constant = 1;
+    if (!t) { return; }
+    invalidate_hot_track(t);
+    t->hash_valid = 0;
+    if (t->ctf_keys) { return; }  // undecoded tracks are classified when decoded
+    t->valid = 0;
+    free(t->table);
+    t->table = NULL;
+    t->bake_pending = 0;
+    if (!t->nkeys) {
+        t->kind = CROCKET_TRACK_EMPTY;
+    }
+    else {
+        // the last key's interpolation mode doesn't matter
+        for (k = t->keys;  k < &t->keys[t->nkeys - 1];  ++k) {
+            if (k[1].value != k[0].value) { constant = 0; }
+            switch (crocket_key_interpol(k)) {
+                case 1:  if (kind < CROCKET_TRACK_LINEAR) { kind = CROCKET_TRACK_LINEAR; }  break;
+                case 2:
+                case 3:  kind = CROCKET_TRACK_GENERAL;  break;
+                default: if (kind < CROCKET_TRACK_STEP) { kind = CROCKET_TRACK_STEP; }  break;
+            }
+        }
+        t->kind = constant ? CROCKET_TRACK_CONSTANT : kind;
+        t->bake_pending = crocket_bake_rate && !constant;
+    }
+    if (t->vector || t->component) {
+        check_shared_keys(t - t->component);
+    }
+}
+
+//! content hash of a single key (see crocket_track_hash())
+static unsigned int hash_key(const crocket_key_t* k) {
+    union _val { float f; unsigned int i; } value;
+    unsigned int h;
+    value.f = k->value;
+    h = (value.i + 0x9E3779B9u) ^ (k->row_mode * 0x85EBCA77u);
+    h ^= h >> 16;  h *= 0x85EBCA6Bu;
+    h ^= h >> 13;  h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+unsigned int crocket_track_hash(crocket_track_t* t) {
+    unsigned int i, hash = 0;
+    if (!t) { return 0; }
+    if (t->ctf_keys) { decode_track(t); }
+    if (!t->hash_valid) {
+        for (i = 0;  i < t->nkeys;  ++i) {
+            hash += hash_key(&t->keys[i]);
+        }
+        t->key_hash = hash;
+        t->hash_valid = 1;
+    }
+    return t->key_hash;
+}
+
+#define BAKE_MAX_RATE          256        //!< maximum table cells per row
+#define BAKE_MAX_CELLS_PER_KEY 256        //!< maximum table cells per key of the track
+#define BAKE_MAX_CELLS         (1u << 20) //!< maximum table cells per track
+
+//! bake a track into a lookup table
+//! \note Each table cell spans 1/crocket_bake_rate rows and stores the value
+//!       at its start and the value just before its end. Since keys are
+//!       always at cell boundaries, this keeps step edges exact.
+static void bake_track(crocket_track_t* t) {
+    const unsigned int rate = crocket_bake_rate;
+    const float step = 1.0f / (float)rate;
+    const crocket_key_t* k = t->keys;
+    const crocket_key_t* k_end = &t->keys[t->nkeys - 1];
+    unsigned long long cells;
+    unsigned int i, size;
+    float* table;
+    t->bake_pending = 0;
+    cells = (unsigned long long)(crocket_key_row(k_end) - crocket_key_row(k)) * rate + 1;
+    if ((cells > BAKE_MAX_CELLS) || (cells > ((unsigned long long)t->nkeys * BAKE_MAX_CELLS_PER_KEY))) {
+        return;  // sparse track: the table would be huge, keep sampling exactly
+    }
+    size = (unsigned int)cells;
+    table = malloc(size * 2 * sizeof(float));
+    if (!table) { return; }  // out of memory: keep sampling exactly
+    for (i = 0;  i < size;  ++i) {
+        float row = (float)(crocket_key_row(&t->keys[0]) + i / rate) + (float)(i % rate) * step;
+        float *cell = &table[2 * i];
+        float err;
+        while ((k < k_end) && ((float)crocket_key_row(&k[1]) <= row)) { ++k; }
+        if ((k >= k_end) || !crocket_key_interpol(k)) {
+            cell[0] = cell[1] = k->value;
+            continue;
+        }
+        cell[0] = crocket_interpolate(k, row);
+        cell[1] = crocket_interpolate(k, row + step);
+        // error check at the center of the cell
+        err = 0.5f * (cell[0] + cell[1]) - crocket_interpolate(k, row + 0.5f * step);
+        if ((err > crocket_bake_max_error) || (err < -crocket_bake_max_error)) {
+            free(table);  // too imprecise: keep sampling exactly
+            return;
+        }
+    }
+    t->table = table;
+    t->table_start = crocket_key_row(&t->keys[0]);
+    t->table_size = size;
+    t->kind = CROCKET_TRACK_BAKED;
+}
+
+//! bake job for run_parallel(): bake every count'th pending track
+static void bake_job(unsigned int index, unsigned int count, void* ctx) {
+    (void) ctx;
+    for (;  index < crocket_ntracks;  index += count) {
+        if (crocket_tracks[index].bake_pending) {
+            bake_track(&crocket_tracks[index]);
+        }
     }
-    return k[0].value + x * (k[1].value - k[0].value);
 }
 
 #ifndef CROCKET_PLAYER_ONLY
 
+//! round to the nearest integer (clamped to +/- 2^30)
+static int quantize(float x) {
+    if (x >  1073741823.0f) { return  1073741823; }
+    if (x < -1073741823.0f) { return -1073741823; }
+    return (int)((x < 0.0f) ? (x - 0.5f) : (x + 0.5f));
+}
+
+//! get the track that the key messages for a server-side track index apply
+//! to: the shadow track of a resent track during a resync, else the track
+//! itself
+//! \returns the track, or NULL if the index is invalid
+static crocket_track_t* remote_track(unsigned int track_index) {
+    unsigned int index;
+    if (track_index >= crocket_nremote) { return NULL; }
+    index = crocket_remote_map[track_index];
+    if (index >= crocket_ntracks) { return NULL; }
+    if (crocket_resync && (index < crocket_nshadow) && crocket_shadow_tracks[index].active) {
+        crocket_resync_time = get_monotonic_time();
+        return &crocket_shadow_tracks[index];
+    }
+    return &crocket_tracks[index];
+}
+
+//! keep the content hash of a track valid after changing a single key
+//! \param hash  the new hash, if the old one was valid (see crocket_track_hash())
+static void update_hash(crocket_track_t* t, int hash_valid, unsigned int hash) {
+    crocket_classify_track(t);  // (invalidates the hash)
+    if (hash_valid) {
+        t->key_hash = hash;
+        t->hash_valid = 1;
+    }
+}
+
 static void set_key(unsigned int track_index, unsigned int row, float value, unsigned char interpol) {
     crocket_track_t* t;
     crocket_key_t* k;
-    unsigned int pos;
-    if (track_index >= ntracks) { return; }
-    t = &crocket_tracks[track_index];
+    unsigned int pos, hash;
+    int hash_valid;
+    if (row > CROCKET_KEY_MAX_ROW) { row = CROCKET_KEY_MAX_ROW; }
+    t = remote_track(track_index);
+    if (!t) { return; }
+    if (t->ctf_keys) {
+        t->ctf_keys = NULL;  // the server's keys replace undecoded ones (nkeys is 0 then)
+        crocket_classify_track(t);
+    }
     pos = crocket_find_key(t, row);
+    hash_valid = t->hash_valid;
+    hash = t->key_hash;
 
     // update existing key
-    if (pos && (t->keys[pos-1].row == row)) {
+    if (pos && (crocket_key_row(&t->keys[pos-1]) == row)) {
         k = &t->keys[pos-1];
+        hash -= hash_key(k);
         k->value = value;
-        k->interpol = interpol;
+        crocket_key_set_row(k, row, interpol);
+        update_hash(t, hash_valid, hash + hash_key(k));
         return;
     }
 
-    // extend memory
-    if (t->nkeys >= t->alloc) {
-        t->alloc = t->alloc ? (t->alloc << 1) : INITIAL_KEY_ALLOC;
-        t->keys = realloc(t->keys, t->alloc * sizeof(crocket_key_t));
-        if (!t->keys) {
-            t->nkeys = t->alloc = 0; return;  // oops, out of memory
+    // extend memory: start with the inline keys, then move to the heap
+    if (!t->alloc) {
+        t->keys = t->inline_keys;
+        t->alloc = CROCKET_INLINE_KEYS;
+    }
+    else if (t->nkeys >= t->alloc) {
+        unsigned int nkeys = t->nkeys;
+        unsigned int new_alloc = has_inline_keys(t) ? INITIAL_KEY_ALLOC : (t->alloc << 1);
+        crocket_key_t* new_keys = alloc_pooled_keys(new_alloc);
+        if (new_keys) {
+            memcpy(new_keys, t->keys, nkeys * sizeof(crocket_key_t));
+        }
+        free_track_keys(t);
+        if (!new_keys) {
+            crocket_classify_track(t);  // oops, out of memory
+            return;
         }
+        t->keys = new_keys;
+        t->nkeys = nkeys;
+        t->alloc = new_alloc;
     }
 
     // insert key = move following keys forward
@@ -171,24 +1075,223 @@ static void set_key(unsigned int track_index, unsigned int row, float value, uns
 
     // set key data
     k = &t->keys[pos];
-    k->row = row;
+    crocket_key_set_row(k, row, interpol);
     k->value = value;
-    k->interpol = interpol;
+    update_hash(t, hash_valid, hash + hash_key(k));
 }
 
 static void delete_key(unsigned int track_index, unsigned int row) {
     crocket_track_t* t;
-    unsigned int pos;
-    if (track_index >= ntracks) { return; }
-    t = &crocket_tracks[track_index];
+    unsigned int pos, hash;
+    int hash_valid;
+    if (row > CROCKET_KEY_MAX_ROW) { row = CROCKET_KEY_MAX_ROW; }
+    t = remote_track(track_index);
+    if (!t) { return; }
+    if (t->ctf_keys) {
+        t->ctf_keys = NULL;  // the server's keys replace undecoded ones (nkeys is 0 then)
+        crocket_classify_track(t);
+    }
     pos = crocket_find_key(t, row);
-    if (!pos || (t->keys[pos-1].row != row)) {
+    if (!pos || (crocket_key_row(&t->keys[pos-1]) != row)) {
         return;  // no such key
     }
+    hash_valid = t->hash_valid;
+    hash = t->key_hash - hash_key(&t->keys[pos-1]);
     if (pos < t->nkeys) {
         memmove(&t->keys[pos-1], &t->keys[pos], (t->nkeys - pos) * sizeof(crocket_key_t));
     }
     --t->nkeys;
+    update_hash(t, hash_valid, hash);
+}
+
+//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//
+
+//! start a resync: the keys resent by the server are collected in the
+//! (emptied) shadow tracks while the current keys keep being sampled
+//! \note In shadow tracks, 'active' marks the tracks that are resent: all
+//!       of them with the plain protocol, only the ones that the server
+//!       clears with the hash sync extension.
+//! \returns zero if the keys shall be updated in place instead, because
+//!          there are no keys to keep yet, or out of memory
+static int begin_resync(void) {
+    crocket_track_t *t, *s;
+    crocket_resync = 0;
+    for (t = crocket_tracks;  t->name && !t->nkeys && !t->ctf_keys;  ++t);
+    if (!t->name) { return 0; }  // nothing to keep
+    if (crocket_shadow_alloc < crocket_ntracks) {
+        unsigned int i;
+        s = realloc(crocket_shadow_tracks, crocket_ntracks * sizeof(crocket_track_t));
+        if (!s) { return 0; }
+        memset(&s[crocket_shadow_alloc], 0, (crocket_ntracks - crocket_shadow_alloc) * sizeof(crocket_track_t));
+        for (i = 0;  i < crocket_shadow_alloc;  ++i) {
+            if (has_inline_keys(&s[i])) { s[i].keys = s[i].inline_keys; }  // the records have moved
+        }
+        crocket_shadow_tracks = s;
+        crocket_shadow_alloc = crocket_ntracks;
+    }
+    for (t = crocket_tracks, s = crocket_shadow_tracks;  t->name;  ++t, ++s) {
+        s->nkeys = 0;  // (keep the memory for the new keys)
+        s->active = (crocket_hash_sync_state != HASH_SYNC_ON);
+        s->vector = t->vector;
+        s->component = t->component;
+        crocket_classify_track(s);
+    }
+    crocket_nshadow = crocket_ntracks;
+    crocket_resync = 1;
+    crocket_resync_time = get_monotonic_time();
+    return 1;
+}
+
+//! exchange the keys of two tracks (without allocating anything)
+static void swap_keys(crocket_track_t* a, crocket_track_t* b) {
+    crocket_key_t* keys = a->keys;
+    unsigned int nkeys = a->nkeys, alloc = a->alloc;
+    crocket_key_t inline_keys[CROCKET_INLINE_KEYS];
+    memcpy(inline_keys, a->inline_keys, sizeof(inline_keys));
+    a->keys = b->keys;
+    a->nkeys = b->nkeys;
+    a->alloc = b->alloc;
+    memcpy(a->inline_keys, b->inline_keys, sizeof(inline_keys));
+    b->keys = keys;
+    b->nkeys = nkeys;
+    b->alloc = alloc;
+    memcpy(b->inline_keys, inline_keys, sizeof(inline_keys));
+    if (has_inline_keys(a)) { a->keys = a->inline_keys; }
+    if (has_inline_keys(b)) { b->keys = b->inline_keys; }
+}
+
+//! finish a resync: make the (resent) shadow tracks current
+//! \note The previous keys stay in the shadow tracks, so the next resync
+//!       can reuse their memory.
+static void finish_resync(void) {
+    unsigned int i;
+    crocket_resync = 0;
+    for (i = 0;  i < crocket_nshadow;  ++i) {
+        if (!crocket_shadow_tracks[i].active) { continue; }
+        swap_keys(&crocket_tracks[i], &crocket_shadow_tracks[i]);
+        crocket_tracks[i].ctf_keys = NULL;
+    }
+    // (classify after swapping everything, because of vector variables)
+    for (i = 0;  i < crocket_nshadow;  ++i) {
+        if (crocket_shadow_tracks[i].active) { crocket_classify_track(&crocket_tracks[i]); }
+    }
+}
+
+//! handle CLEAR_TRACK: the server is about to resend the keys of a track
+//! because its hash differs
+static void clear_track(unsigned int track_index) {
+    crocket_track_t* t;
+    if ((track_index < crocket_nremote) && (crocket_remote_map[track_index] < crocket_nshadow)) {
+        // the keys go into the shadow track now (if still resyncing)
+        crocket_shadow_tracks[crocket_remote_map[track_index]].active = 1;
+    }
+    t = remote_track(track_index);
+    if (!t) { return; }
+    t->nkeys = 0;
+    t->ctf_keys = NULL;
+    crocket_classify_track(t);
+}
+
+//! free the shadow tracks and their keys
+static void free_shadow_tracks(void) {
+    unsigned int i;
+    for (i = 0;  i < crocket_shadow_alloc;  ++i) {
+        free_track_keys(&crocket_shadow_tracks[i]);
+    }
+    free(crocket_shadow_tracks);
+    crocket_shadow_tracks = NULL;
+    crocket_nshadow = crocket_shadow_alloc = 0;
+    crocket_resync = 0;
+}
+
+//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//
+
+#define OPTIMIZE_SUBSAMPLES 4  //!< number of error checks per row in crocket_optimize_track()
+
+//! check whether a key can be removed without changing the curve too much
+//! \param orig  the original (unmodified) track to compare against
+//! \param prev  the key that would precede the removed one (NULL if none)
+//! \param key   the key to remove
+//! \param next  the key that would follow the removed one (NULL if none)
+static int is_key_redundant(const crocket_track_t* orig, const crocket_key_t* prev, const crocket_key_t* key, const crocket_key_t* next, float tolerance) {
+    crocket_key_t seg[2];
+    unsigned int i, count;
+    float row0;
+    if (!prev && !next) { return 0; }  // never remove the last remaining key
+    seg[0] = prev ? *prev : *key;
+    seg[1] = next ? *next : *key;
+    row0 = (float)crocket_key_row(prev ? prev : key);
+    count = (crocket_key_row(next ? next : key) - (unsigned int)row0) * OPTIMIZE_SUBSAMPLES;
+    for (i = 0;  i <= count;  ++i) {
+        float row = row0 + (float)i * (1.0f / OPTIMIZE_SUBSAMPLES);
+        float x = !prev ? next->value
+                : (next && (i == count)) ? next->value
+                : (!next || !crocket_key_interpol(prev)) ? prev->value
+                : crocket_interpolate(seg, row);
+        x -= crocket_sample(orig, row);
+        if ((x > tolerance) || (x < -tolerance)) { return 0; }
+    }
+    return 1;
+}
+
+unsigned int crocket_optimize_track(crocket_track_t* t, float tolerance, float precision) {
+    crocket_track_t orig;
+    unsigned int i, n;
+    if (t && t->ctf_keys) { decode_track(t); }
+    if (!t || !t->nkeys) { return 0; }
+
+    // quantize values
+    if (precision > 0.0f) {
+        for (i = 0;  i < t->nkeys;  ++i) {
+            t->keys[i].value = (float)quantize(t->keys[i].value / precision) * precision;
+        }
+    }
+
+    // keep a copy of the (quantized) original keys to measure errors against
+    memcpy(&orig, t, sizeof(orig));
+    orig.kind = CROCKET_TRACK_GENERAL;  // always compare against the exact curve
+    orig.table = NULL;
+    orig.keys = alloc_keys(t->nkeys);
+    if (!orig.keys) { return 0; }
+    memcpy(orig.keys, t->keys, t->nkeys * sizeof(crocket_key_t));
+
+    // remove redundant keys; each decision is checked against the original
+    // curve over the full span of the resulting segment, so errors don't add up
+    for (i = n = 0;  i < orig.nkeys;  ++i) {
+        if (!is_key_redundant(&orig, n ? &t->keys[n-1] : NULL, &orig.keys[i],
+                              ((i + 1) < orig.nkeys) ? &orig.keys[i+1] : NULL, tolerance)) {
+            t->keys[n++] = orig.keys[i];
+        }
+    }
+    t->nkeys = n;
+    crocket_classify_track(t);
+    free_keys(orig.keys, orig.nkeys);
+    return orig.nkeys - n;
+}
+
+unsigned int crocket_optimize(float tolerance, float precision) {
+    crocket_track_t* t;
+    unsigned int removed = 0;
+    crocket_prefetch(NULL);
+    for (t = crocket_tracks;  t->name;  ++t) {
+        removed += crocket_optimize_track(t, tolerance, precision);
+    }
+    return removed;
+}
+
+#else // CROCKET_PLAYER_ONLY
+
+unsigned int crocket_optimize_track(crocket_track_t* t, float tolerance, float precision) {
+    (void) t;
+    (void) tolerance;
+    (void) precision;
+    return 0;
+}
+
+unsigned int crocket_optimize(float tolerance, float precision) {
+    (void) tolerance;
+    (void) precision;
+    return 0;
 }
 
 #endif // CROCKET_PLAYER_ONLY
@@ -200,11 +1303,225 @@ static void delete_key(unsigned int track_index, unsigned int row) {
 
 #ifndef CROCKET_PLAYER_ONLY
 
-static void disconnect(void) {
+//! transport layer for the connection to the server
+typedef struct _transport {
+    int  (*open)(void);     //!< connect to the server; nonzero if successful
+    void (*close)(void);    //!< close the connection
+    int  (*is_open)(void);  //!< check whether the connection is open
+    int  (*send)(const void* data, int bytes);  //!< send some data, return number of bytes sent or <= 0 on error
+    int  (*recv)(void* data, int bytes);        //!< receive some data (blocking), return number of bytes received or <= 0 on error
+    int  (*recv_available)(void* data, int bytes);  //!< receive available data (non-blocking), return number of bytes received, 0 if none or < 0 on error
+    int  (*poll)(int *p_timeout_usec);          //!< wait for incoming data and update remaining timeout;
+                                                //!< returns > 0 if data is available, 0 on timeout, < 0 on error
+} transport_t;
+
+//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//
+
+static int socket_open(void) {
+#ifdef _WIN32
+    DWORD timeout = RECONNECT_TIMEOUT, notimeout = 0;
+#else
+    struct timeval timeout, notimeout;
+    timeout.tv_sec = (RECONNECT_TIMEOUT / 1000);
+    timeout.tv_usec = (RECONNECT_TIMEOUT % 1000) * 1000;
+    notimeout.tv_sec = notimeout.tv_usec = 0;
+#endif
+
+    // create socket (TCP or Unix domain, depending on the address)
+    crocket_socket = socket(crocket_server_address.ss_family, SOCK_STREAM, 0);
+    if (crocket_socket == INVALID_SOCKET) { return 0; }
+
+    // set timeout for connect()
+    setsockopt(crocket_socket, SOL_SOCKET, SO_SNDTIMEO, (void*)&timeout, sizeof(timeout));
+    setsockopt(crocket_socket, SOL_SOCKET, SO_RCVTIMEO, (void*)&timeout, sizeof(timeout));
+
+    // connect to server
+    if (connect(crocket_socket, (const struct sockaddr*)&crocket_server_address, crocket_server_address_len)) {
+        return 0;
+    }
+
+    // reset timeout
+    setsockopt(crocket_socket, SOL_SOCKET, SO_SNDTIMEO, (void*)&notimeout, sizeof(notimeout));
+    setsockopt(crocket_socket, SOL_SOCKET, SO_RCVTIMEO, (void*)&notimeout, sizeof(notimeout));
+    return 1;
+}
+
+static void socket_close(void) {
     if (crocket_socket != INVALID_SOCKET) {
         closesocket(crocket_socket);
         crocket_socket = INVALID_SOCKET;
     }
+}
+
+static int socket_is_open(void) {
+    return (crocket_socket != INVALID_SOCKET);
+}
+
+static int socket_send(const void* data, int bytes) {
+    return send(crocket_socket, data, bytes, 0);
+}
+
+static int socket_recv(void* data, int bytes) {
+    return recv(crocket_socket, data, bytes, 0);
+}
+
+static int socket_poll(int *p_timeout_usec) {
+    struct timeval tv;
+    fd_set fds;
+    int res;
+    tv.tv_sec = 0;  // note: the timeout *must* be less than 1 million microseconds!
+    tv.tv_usec = *p_timeout_usec;
+    FD_ZERO(&fds);
+    FD_SET(crocket_socket, &fds);
+    res = select((int)crocket_socket + 1, &fds, NULL, NULL, &tv);
+    *p_timeout_usec = (int)tv.tv_usec;  // (only updated on some platforms)
+    return (res < 0) ? -1 : res;
+}
+
+static int socket_recv_available(void* data, int bytes) {
+#ifdef _WIN32
+    u_long avail = 0;
+    if (ioctlsocket(crocket_socket, FIONREAD, &avail)) { return -1; }
+    if (!avail) {
+        // no data; if the socket is readable anyway, the connection has been closed
+        int timeout_usec = 0;
+        return socket_poll(&timeout_usec) ? -1 : 0;
+    }
+    return recv(crocket_socket, data, ((int)avail < bytes) ? (int)avail : bytes, 0);
+#else
+    int res = (int)recv(crocket_socket, data, bytes, MSG_DONTWAIT);
+    if ((res < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))) { return 0; }
+    return res ? res : -1;  // (0 = connection closed)
+#endif
+}
+
+//! transport for TCP and Unix domain sockets
+static const transport_t socket_transport = {
+    socket_open, socket_close, socket_is_open, socket_send, socket_recv, socket_recv_available, socket_poll
+};
+
+//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//
+
+//! give up the CPU for a short while (about 100 microseconds, or less)
+static void short_sleep(void) {
+#ifdef _WIN32
+    Sleep(0);
+#else
+    usleep(100);
+#endif
+}
+
+//! check whether the server side of the shared memory transport is still there
+#define shm_session_alive() (crocket_shm->server_session == crocket_shm_session)
+
+static void shm_close(void) {
+    if (!crocket_shm) { return; }
+    if (shm_session_alive()) {
+        crocket_shm->client_attached = 0;  // (otherwise, the server already reset it)
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(crocket_shm);
+    CloseHandle(crocket_shm_handle);
+    crocket_shm_handle = NULL;
+#else
+    munmap(crocket_shm, sizeof(crocket_shm_transport_t));
+#endif
+    crocket_shm = NULL;
+}
+
+static int shm_open_transport(void) {
+    void* mem;
+    char* name = shm_object_name(crocket_shm_name);
+    if (!name) { return 0; }
+#ifdef _WIN32
+    crocket_shm_handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+    mem = crocket_shm_handle ? MapViewOfFile(crocket_shm_handle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(crocket_shm_transport_t)) : NULL;
+    if (!mem && crocket_shm_handle) {
+        CloseHandle(crocket_shm_handle);
+        crocket_shm_handle = NULL;
+    }
+#else
+    {
+        struct stat st;
+        int fd = shm_open(name, O_RDWR, 0);
+        mem = NULL;
+        if ((fd >= 0) && !fstat(fd, &st) && ((size_t)st.st_size >= sizeof(crocket_shm_transport_t))) {
+            mem = mmap(NULL, sizeof(crocket_shm_transport_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (mem == MAP_FAILED) { mem = NULL; }
+        }
+        if (fd >= 0) { close(fd); }
+    }
+#endif
+    free(name);
+    if (!mem) { return 0; }
+    crocket_shm = mem;
+
+    // check whether the server is ready to accept us, then attach
+    crocket_shm_session = crocket_shm->server_session;
+    if (memcmp(crocket_shm->signature, CROCKET_SHM_TRANSPORT_SIGNATURE, 8)
+    ||  (crocket_shm->version != CROCKET_SHM_TRANSPORT_VERSION)
+    ||  !crocket_shm_session || crocket_shm->client_attached) {
+        shm_close();
+        return 0;
+    }
+    MEMORY_BARRIER();
+    crocket_shm->client_attached = 1;
+    return 1;
+}
+
+static int shm_is_open(void) {
+    return (crocket_shm != NULL);
+}
+
+static int shm_send(const void* data, int bytes) {
+    int retries = SHM_IO_TIMEOUT * 10;
+    while (shm_session_alive() && (--retries > 0)) {
+        int res = crocket_ring_write(&crocket_shm->to_server, data, bytes);
+        if (res > 0) { return res; }
+        short_sleep();  // ring buffer full, wait for the server
+    }
+    return -1;
+}
+
+static int shm_recv(void* data, int bytes) {
+    int retries = SHM_IO_TIMEOUT * 10;
+    while (shm_session_alive() && (--retries > 0)) {
+        int res = crocket_ring_read(&crocket_shm->to_client, data, bytes);
+        if (res > 0) { return res; }
+        short_sleep();  // ring buffer empty, wait for the server
+    }
+    return -1;  // server gone or not responding
+}
+
+static int shm_recv_available(void* data, int bytes) {
+    if (!shm_session_alive()) { return -1; }
+    return crocket_ring_read(&crocket_shm->to_client, data, bytes);
+}
+
+static int shm_poll(int *p_timeout_usec) {
+    for (;;) {
+        if (!shm_session_alive()) { return -1; }
+        if (crocket_shm->to_client.head != crocket_shm->to_client.tail) { return 1; }
+        if (*p_timeout_usec <= 0) { return 0; }
+        short_sleep();
+        *p_timeout_usec -= 100;
+    }
+}
+
+//! transport for shared memory ring buffers
+static const transport_t shm_transport = {
+    shm_open_transport, shm_close, shm_is_open, shm_send, shm_recv, shm_recv_available, shm_poll
+};
+
+const transport_t* crocket_transport = &socket_transport;  //!< current transport layer
+
+//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//
+
+static void disconnect(void) {
+    crocket_transport->close();
+    crocket_rx_size = 0;
+    crocket_resync = 0;  // incomplete: keep the previous keys
+    crocket_hash_sync_state = HASH_SYNC_OFF;
     if (crocket_current_state & CROCKET_STATE_CONNECTED) {
         crocket_current_state |= CROCKET_EVENT_DISCONNECT;
     }
@@ -213,9 +1530,9 @@ static void disconnect(void) {
 
 static int xsend(const void* data, int bytes) {
     const char* data_pos = data;
-    if (crocket_socket == INVALID_SOCKET) { return 0; }
+    if (!crocket_transport->is_open()) { return 0; }
     while (bytes > 0) {
-        int res = send(crocket_socket, data_pos, bytes, 0);
+        int res = crocket_transport->send(data_pos, bytes);
         if (res <= 0) {
             disconnect();
             return 0;
@@ -228,9 +1545,9 @@ static int xsend(const void* data, int bytes) {
 
 static int xrecv(void* data, int bytes) {
     char* data_pos = data;
-    if (crocket_socket == INVALID_SOCKET) { return 0; }
+    if (!crocket_transport->is_open()) { return 0; }
     while (bytes > 0) {
-        int res = recv(crocket_socket, data_pos, bytes, 0);
+        int res = crocket_transport->recv(data_pos, bytes);
         if (res <= 0) {
             disconnect();
             return 0;
@@ -241,32 +1558,26 @@ static int xrecv(void* data, int bytes) {
     return 1;
 }
 
-static int handle_messages(int timeout_usec) {
-    struct timeval tv;
-    if (crocket_socket == INVALID_SOCKET) { return 0; }
-    tv.tv_sec = 0;  // note: timeout_usec *must* be less than 1 million!
-    tv.tv_usec = timeout_usec;
-    for (;;) {
-        unsigned char cmd;
-
-        // new message pending?
-        fd_set fds;
-        int res;
-        FD_ZERO(&fds);
-        FD_SET(crocket_socket, &fds);
-        res = select((int)crocket_socket + 1, &fds, NULL, NULL, &tv);
-        if (res == 0) {
-            return 1;  // no new messages
-        }
-        if (res != 1) {
-            // an error occurred
-            disconnect();
-            return 0;  
+//! process all complete messages in the receive buffer
+static void parse_messages(void) {
+    const unsigned char* pos = crocket_rx_buffer;
+    const unsigned char* end = &crocket_rx_buffer[crocket_rx_size];
+    while (pos < end) {
+        int size;
+
+        // get message size; stop if the message is incomplete
+        switch (*pos) {
+            case 0:  size = 14; break;  // SET_KEY
+            case 1:  size =  9; break;  // DELETE_KEY
+            case 3:  size =  5; break;  // SET_ROW
+            case 4:  size =  2; break;  // PAUSE
+            case 6:  size =  5; break;  // ACTION
+            case 8:  size =  5; break;  // CLEAR_TRACK (hash sync extension)
+            default: size =  1; break;  // SAVE_TRACKS or unknown command
         }
+        if ((end - pos) < size) { break; }
 
-        // read command
-        if (!xrecv(&cmd, 1)) { return 0; }
-        switch (cmd) {
+        switch (*pos) {
 
             case 0: {  // SET_KEY
                 #pragma pack(push, 1)
@@ -277,7 +1588,7 @@ static int handle_messages(int timeout_usec) {
                     unsigned char interpol;
                 } p;
                 #pragma pack(pop)
-                if (!xrecv(&p, 13)) { return 0; }
+                memcpy(&p, &pos[1], 13);
                 p.value.i = ntohl(p.value.i);
                 set_key(ntohl(p.track_index), ntohl(p.row), p.value.f, p.interpol);
                 break; }
@@ -289,55 +1600,169 @@ static int handle_messages(int timeout_usec) {
                     unsigned int row;
                 } p;
                 #pragma pack(pop)
-                if (!xrecv(&p, 8)) { return 0; }
+                memcpy(&p, &pos[1], 8);
                 delete_key(ntohl(p.track_index), ntohl(p.row));
                 break; }
 
             case 3: { // SET_ROW
                 unsigned int row;
-                if (!xrecv(&row, 4)) { return 0; }
+                memcpy(&row, &pos[1], 4);
                 crocket_current_row = ntohl(row);
                 crocket_current_state |= CROCKET_EVENT_SEEK;
                 break; }
 
-            case 4: { // PAUSE
-                unsigned char mode;
-                if (!xrecv(&mode, 1)) { return 0; }
-                if (mode) {
+            case 4: // PAUSE
+                if (pos[1]) {
                     crocket_current_state = (crocket_current_state | CROCKET_EVENT_STOP) & (~(CROCKET_EVENT_PLAY | CROCKET_STATE_PLAYING));
                 }
                 else {
                     crocket_current_state = (crocket_current_state | (CROCKET_EVENT_PLAY | CROCKET_STATE_PLAYING)) & (~CROCKET_EVENT_STOP);
                 }
+                break;
+
+            case 5: // SAVE_TRACKS
+                crocket_current_state |= CROCKET_EVENT_SAVE;
+                break;
+
+            case 6: { // ACTION
+                unsigned int action;
+                memcpy(&action, &pos[1], 4);
+                crocket_current_state |= CROCKET_EVENT_ACTION(ntohl(action));
+                break; }
+
+            case 7: // HASH_SYNC (advertisement of the extension)
+                if (crocket_hash_sync_state == HASH_SYNC_PROBING) {
+                    crocket_hash_sync_state = HASH_SYNC_ON;
+                }
+                break;
+
+            case 8: { // CLEAR_TRACK
+                unsigned int track_index;
+                memcpy(&track_index, &pos[1], 4);
+                clear_track(ntohl(track_index));
                 break; }
 
-            case 5: // SAVE_TRACKS
-                crocket_current_state |= CROCKET_EVENT_SAVE;
-                break;
+            default:  // unknown command
+                break;
+        }   // end of command switch
+        pos += size;
+    }   // end of message parsing loop
+
+    // keep incomplete messages for later
+    crocket_rx_size = (int)(end - pos);
+    memmove(crocket_rx_buffer, pos, crocket_rx_size);
+}
+
+//! receive data into the receive buffer and process it
+//! \param nonblocking  if nonzero, read everything that's available;
+//!                     otherwise, wait for at least one byte
+//! \returns zero on error
+static int receive_messages(int nonblocking) {
+    do {
+        int res = (nonblocking ? crocket_transport->recv_available : crocket_transport->recv)
+                  (&crocket_rx_buffer[crocket_rx_size], (int)sizeof(crocket_rx_buffer) - crocket_rx_size);
+        if (!res && nonblocking) { return 1; }  // no more data
+        if (res <= 0) {
+            disconnect();
+            return 0;
+        }
+        crocket_rx_size += res;
+        parse_messages();
+    } while (nonblocking);
+    return 1;
+}
+
+static int handle_messages(int timeout_usec) {
+    if (!crocket_transport->is_open()) { return 0; }
+    for (;;) {
+        // new message pending?
+        int res = crocket_transport->poll(&timeout_usec);
+        if (res == 0) {
+            return 1;  // no new messages
+        }
+        if (res < 0) {
+            // an error occurred
+            disconnect();
+            return 0;
+        }
+        if (!receive_messages(0)) { return 0; }
+    }
+}
+
+//! send a GET_TRACK request (or GET_TRACK_HASHED, if 'hash' isn't NULL)
+//! \note The server identifies tracks by the order of the requests, so the
+//!       local track index is also added to the remote index map here.
+static int send_track_request(unsigned int index, const char* name, const unsigned int* hash) {
+    #pragma pack(push, 1)
+    struct _get_track_cmd {
+        unsigned char cmd;
+        unsigned int name_length;
+    } cmd;
+    #pragma pack(pop)
+    unsigned int name_length = (unsigned int)strlen(name);
+    if (crocket_nremote >= crocket_remote_alloc) {
+        unsigned int new_alloc = crocket_remote_alloc ? (crocket_remote_alloc << 1) : 64;
+        unsigned int* new_map = realloc(crocket_remote_map, new_alloc * sizeof(unsigned int));
+        if (!new_map) {
+            disconnect();  // without a mapping, the server's messages can't be handled
+            return 0;
+        }
+        crocket_remote_map = new_map;
+        crocket_remote_alloc = new_alloc;
+    }
+    crocket_remote_map[crocket_nremote++] = index;
+    cmd.cmd = hash ? 7 : 2;  // GET_TRACK_HASHED or GET_TRACK
+    cmd.name_length = htonl(name_length);
+    if (!xsend(&cmd, 5) || !xsend(name, name_length)) { return 0; }
+    if (hash) {
+        unsigned int h = htonl(*hash);
+        return xsend(&h, 4);
+    }
+    return 1;
+}
+
+//! request the keys of a track from the server
+//! \note With the hash sync extension, the server only sends the keys if
+//!       they differ from the ones we already have.
+static int request_track(crocket_track_t* t) {
+    unsigned int hash;
+    if (crocket_resync) {
+        crocket_resync_time = get_monotonic_time();  // wait for the answer
+    }
+    if (crocket_hash_sync_state == HASH_SYNC_ON) {
+        hash = crocket_track_hash(t);
+        return send_track_request((unsigned int)(t - crocket_tracks), t->name, &hash);
+    }
+    return send_track_request((unsigned int)(t - crocket_tracks), t->name, NULL);
+}
 
-            case 6: { // ACTION
-                unsigned int action;
-                if (!xrecv(&action, 4)) { return 0; }
-                crocket_current_state |= CROCKET_EVENT_ACTION(ntohl(action));
-                break; }
+//! negotiate the hash sync extension: a supporting server sends a HASH_SYNC
+//! message right along with its greeting, so it's already there if it's
+//! coming at all; nothing is sent to servers without the extension
+//! \returns zero if the connection broke
+static int probe_hash_sync(void) {
+    crocket_hash_sync_state = HASH_SYNC_PROBING;
+    if (!receive_messages(1)) { return 0; }
+    if (crocket_hash_sync_state == HASH_SYNC_PROBING) {
+        crocket_hash_sync_state = HASH_SYNC_OFF;  // no advertisement: plain server
+    }
+    return 1;
+}
 
-            default:  // unknown command
-                break;
-        }   // end of command switch
-    }   // end of message receive loop
+//! mark a track as active, and request it from the server if connected
+static int activate_track(crocket_track_t* t) {
+    if (t->active) { return 0; }
+    t->active = 1;
+    if (crocket_current_state & CROCKET_STATE_CONNECTED) {
+        request_track(t);
+    }
+    return 1;
 }
 
 static void reconnect(void) {
     crocket_track_t* t;
     char server_greet[12];
-#ifdef _WIN32
-    DWORD timeout = RECONNECT_TIMEOUT, notimeout = 0;
-#else
-    struct timeval timeout, notimeout;
-    timeout.tv_sec = (RECONNECT_TIMEOUT / 1000);
-    timeout.tv_usec = (RECONNECT_TIMEOUT % 1000) * 1000;
-    notimeout.tv_sec = notimeout.tv_usec = 0;
-#endif
+    int resync;
 
     // don't do anything if connected, else clean up the connection first
     if ((crocket_mode == CROCKET_MODE_PLAYER)
@@ -345,24 +1770,12 @@ static void reconnect(void) {
         { return; }
     disconnect();
 
-    // create socket
-    crocket_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (crocket_socket == INVALID_SOCKET) { return; }
-
-    // set timeout for connect()
-    setsockopt(crocket_socket, SOL_SOCKET, SO_SNDTIMEO, (void*)&timeout, sizeof(timeout));
-    setsockopt(crocket_socket, SOL_SOCKET, SO_RCVTIMEO, (void*)&timeout, sizeof(timeout));
-
     // connect to server
-    if (connect(crocket_socket, (const struct sockaddr*)&crocket_server_address, sizeof(crocket_server_address))) {
+    if (!crocket_transport->open()) {
         disconnect();
         return;
     }
 
-    // reset timeout
-    setsockopt(crocket_socket, SOL_SOCKET, SO_SNDTIMEO, (void*)&notimeout, sizeof(notimeout));
-    setsockopt(crocket_socket, SOL_SOCKET, SO_RCVTIMEO, (void*)&notimeout, sizeof(notimeout));
-
     // CLIENT_GREET - SERVER_GREET exchange
     if (!xsend("hello, synctracker!", 19)
     ||  !xrecv(server_greet, 12)
@@ -371,23 +1784,25 @@ static void reconnect(void) {
         return;
     }
 
-    // give the server a list of all tracks (and clear them while we're at it)
+    // give the server a list of all (active) tracks; the keys it sends
+    // are collected in the shadow tracks until the resync is complete,
+    // so the current keys can still be used in the meantime
+    crocket_nremote = 0;
+    if (crocket_hash_sync && !probe_hash_sync()) { return; }
+    resync = begin_resync();
     for (t = crocket_tracks;  t->name;  ++t) {
-        #pragma pack(push, 1)
-        struct _get_track_cmd {
-            unsigned char cmd;
-            unsigned int name_length;
-        } cmd;
-        #pragma pack(pop)
-        unsigned int name_length = (unsigned int)strlen(t->name);
-        t->nkeys = 0;
-        cmd.cmd = 2;  // GET_TRACK
-        cmd.name_length = htonl(name_length);
-        if (!xsend(&cmd, 5) || !xsend(t->name, name_length) || !handle_messages(0)) { return; }
+        if (!resync) {
+            t->nkeys = 0;  // no shadow tracks: clear the tracks right away
+            t->ctf_keys = NULL;  // (including undecoded keys from the track data)
+            crocket_classify_track(t);
+        }
+        if (!crocket_lazy) { t->active = 1; }
+        if (t->active && (!request_track(t) || !handle_messages(0))) { return; }
     }
 
     // finally, wait up to 100 ms for the server to settle
-    if (!handle_messages(100000)) {
+    // (in lazy mode, the keys will arrive while we're running)
+    if (!crocket_lazy && !handle_messages(100000)) {
         return;
     }
 
@@ -395,13 +1810,466 @@ static void reconnect(void) {
     crocket_current_state |= CROCKET_STATE_CONNECTED | CROCKET_EVENT_CONNECT;
 }
 
+void crocket_set_hash_sync(int enable) {
+    crocket_hash_sync = enable;
+}
+
+void crocket_set_lazy(int enable) {
+    crocket_lazy = enable;
+    if (!enable) {
+        crocket_activate("");  // request everything that's still missing
+    }
+}
+
+unsigned int crocket_activate(const char* prefix) {
+    crocket_track_t* t;
+    size_t len = prefix ? strlen(prefix) : 0;
+    unsigned int count = 0;
+    for (t = crocket_tracks;  t->name;  ++t) {
+        if (!t->active && (!len || !strncmp(t->name, prefix, len))) {
+            count += activate_track(t);
+        }
+    }
+    return count;
+}
+
+//! lazy mode: activate all tracks that crocket_update() samples
+//! \note This only runs if tracks have been added to the enabled groups
+//!       since the last call, so it doesn't cost anything per frame.
+static void activate_sampled_tracks(void) {
+    crocket_sampled_changed = 0;
+    if (crocket_grouped_tracks == crocket_ntracks) {
+        const group_run_t* r;
+        for (r = crocket_runs;  r < &crocket_runs[crocket_nruns];  ++r) {
+            crocket_track_t* t;
+            if (!crocket_groups[r->group].enabled) { continue; }
+            for (t = &crocket_tracks[r->start];  t < &crocket_tracks[r->end];  ++t) {
+                activate_track(t);
+            }
+        }
+    }
+    else {
+        crocket_activate("");  // no group information
+    }
+}
+
+crocket_socket_t crocket_get_socket(int *p_events) {
+    if (p_events) { *p_events = 0; }
+    if (crocket_transport != &socket_transport) {
+        return CROCKET_NO_SOCKET;  // other transports keep being polled in crocket_update()
+    }
+    crocket_external_polling = 1;
+    if (crocket_socket == INVALID_SOCKET) {
+        return CROCKET_NO_SOCKET;
+    }
+    if (p_events) { *p_events = CROCKET_POLL_READ; }
+    return (crocket_socket_t)crocket_socket;
+}
+
+int crocket_on_readable(void) {
+    if (!crocket_transport->is_open()) { return 0; }
+    return receive_messages(1);
+}
+
+void crocket_release_socket(void) {
+    crocket_external_polling = 0;
+}
+
 #else // CROCKET_PLAYER_ONLY
 
 #define reconnect()
+#define activate_track(t)
+
+void crocket_set_hash_sync(int enable) {
+    (void) enable;
+}
+
+void crocket_set_lazy(int enable) {
+    (void) enable;
+}
+
+unsigned int crocket_activate(const char* prefix) {
+    (void) prefix;
+    return 0;
+}
+
+crocket_socket_t crocket_get_socket(int *p_events) {
+    if (p_events) { *p_events = 0; }
+    return CROCKET_NO_SOCKET;
+}
+
+int crocket_on_readable(void) {
+    return 0;
+}
+
+void crocket_release_socket(void) {
+}
 
 #endif // CROCKET_PLAYER_ONLY
 
 
+///////////////////////////////////////////////////////////////////////////////
+///// SHARED MEMORY PUBLISHING                                            /////
+///////////////////////////////////////////////////////////////////////////////
+
+static void unpublish(void) {
+    if (!crocket_shared) { return; }
+#ifdef _WIN32
+    UnmapViewOfFile(crocket_shared);
+    CloseHandle(crocket_shared_handle);
+    crocket_shared_handle = NULL;
+#else
+    munmap(crocket_shared, crocket_shared_size);
+    shm_unlink(crocket_shared_name);
+#endif
+    free(crocket_shared_name);
+    crocket_shared_name = NULL;
+    crocket_shared = NULL;
+    crocket_shared_size = 0;
+}
+
+int crocket_publish(const char* name) {
+    crocket_shared_track_t* dir;
+    const crocket_track_t* t;
+    char* names;
+    size_t size, names_size = 0;
+    void* mem;
+    unpublish();
+    if (!name || !name[0]) { return 1; }
+
+    // compute the layout
+    for (t = crocket_tracks;  t->name;  ++t) {
+        names_size += strlen(t->name) + 1;
+    }
+    size = sizeof(crocket_shared_values_t) + crocket_ntracks * sizeof(crocket_shared_track_t) + names_size;
+    size = (size + 3) & (~(size_t)3);
+    size += crocket_ntracks * sizeof(float);
+
+    // create and map the segment
+    crocket_shared_name = shm_object_name(name);
+    if (!crocket_shared_name) { return 0; }
+#ifdef _WIN32
+    crocket_shared_handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)size, crocket_shared_name);
+    if (!crocket_shared_handle) {
+        free(crocket_shared_name);
+        crocket_shared_name = NULL;
+        return 0;
+    }
+    mem = MapViewOfFile(crocket_shared_handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!mem) {
+        CloseHandle(crocket_shared_handle);
+        crocket_shared_handle = NULL;
+        free(crocket_shared_name);
+        crocket_shared_name = NULL;
+        return 0;
+    }
+#else
+    {
+        int fd = shm_open(crocket_shared_name, O_CREAT | O_RDWR, 0644);
+        if ((fd < 0) || ftruncate(fd, (off_t)size)) {
+            if (fd >= 0) { close(fd); shm_unlink(crocket_shared_name); }
+            free(crocket_shared_name);
+            crocket_shared_name = NULL;
+            return 0;
+        }
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mem == MAP_FAILED) {
+            shm_unlink(crocket_shared_name);
+            free(crocket_shared_name);
+            crocket_shared_name = NULL;
+            return 0;
+        }
+    }
+#endif
+
+    // fill in the header and the track directory
+    memset(mem, 0, size);
+    crocket_shared = mem;
+    crocket_shared_size = size;
+    crocket_shared->ntracks = crocket_ntracks;
+    crocket_shared->directory_offset = sizeof(crocket_shared_values_t);
+    crocket_shared->values_offset = (unsigned int)(size - crocket_ntracks * sizeof(float));
+    dir = (crocket_shared_track_t*)((char*)mem + crocket_shared->directory_offset);
+    names = (char*)&dir[crocket_ntracks];
+    for (t = crocket_tracks;  t->name;  ++t, ++dir) {
+        size_t len = strlen(t->name) + 1;
+        memcpy(names, t->name, len);
+        dir->name_offset = (unsigned int)(names - (char*)mem);
+        dir->value_offset = crocket_shared->values_offset + (unsigned int)((t - crocket_tracks) * sizeof(float));
+        names += len;
+    }
+    crocket_shared->version = CROCKET_SHARED_VALUES_VERSION;
+    MEMORY_BARRIER();
+    memcpy(crocket_shared->signature, CROCKET_SHARED_VALUES_SIGNATURE, 8);
+    return 1;
+}
+
+//! write the current state into the shared memory segment
+static void publish_values(float time, float row, int state) {
+    crocket_shared_values_t* sh = crocket_shared;
+    float* values = (float*)((char*)sh + sh->values_offset);
+    unsigned int seq = sh->sequence, i;
+    sh->sequence = seq + 1;  // odd sequence number = update in progress
+    MEMORY_BARRIER();
+    sh->state = state;
+    sh->time = time;
+    sh->row = row;
+    for (i = 0;  i < sh->ntracks;  ++i) {  // (tracks registered later aren't published)
+        *values++ = *crocket_tracks[i].p_var;
+    }
+    MEMORY_BARRIER();
+    sh->sequence = seq + 2;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+///// CLOCK SYNCHRONIZATION                                               /////
+///////////////////////////////////////////////////////////////////////////////
+
+#define SYNC_DEFAULT_ADDRESS "239.255.13.38:1338"  //!< default multicast group
+#define SYNC_SIGNATURE       "crocksyn"  //!< signature of sync packets
+#define SYNC_INTERVAL        0.05   //!< leader: seconds between packets
+#define SYNC_JUMP_THRESHOLD  0.25f  //!< offset (in seconds) above which followers seek instead of slewing
+#define SYNC_SLEW_RATE       0.05f  //!< maximum slew rate (in seconds per second)
+#define SYNC_DRIFT_SMOOTHING 0.05f  //!< weight of new measurements in the drift estimate
+
+//! sync packet, as sent over the network (all fields in network byte order)
+typedef struct _sync_packet {
+    char signature[8];          //!< SYNC_SIGNATURE
+    unsigned int session;       //!< random ID of the leader instance
+    unsigned int sequence;      //!< packet counter
+    unsigned int seeks;         //!< number of seeks performed by the leader
+    unsigned int playing;       //!< nonzero if the leader is playing
+    unsigned int time;          //!< leader's time in seconds (float bits)
+} sync_packet_t;
+
+//! clock synchronization state
+typedef struct _sync_state {
+    unsigned int session;       //!< leader session ID (own or followed)
+    unsigned int sequence;      //!< last sent or received packet number
+    unsigned int seeks;         //!< leader seek counter (own or last seen)
+    int playing;                //!< leader play state (own or last seen)
+    int have_leader;            //!< follower: nonzero if any packet was received
+    int seek_pending;           //!< follower: a seek has just been signalled
+    float leader_time;          //!< time in the last packet sent or received
+    double packet_time;         //!< local time when that packet was sent or received
+    double update_time;         //!< local time of the last crocket_update()
+    float correction;           //!< follower: offset added to the application time
+    float last_target;          //!< follower: correction target at the last packet
+    double last_target_time;    //!< follower: local time of last_target
+} sync_state_t;
+static sync_state_t crocket_sync_state;
+
+static void sync_close(void) {
+    if (crocket_sync_socket != INVALID_SOCKET) {
+        closesocket(crocket_sync_socket);
+        crocket_sync_socket = INVALID_SOCKET;
+    }
+    crocket_sync_role = CROCKET_SYNC_OFF;
+}
+
+int crocket_sync(int role, const char* address) {
+    struct addrinfo hints, *res = NULL;
+    char *host, *port;
+    int ok = 0, one = 1;
+
+    sync_close();
+    memset(&crocket_sync_state, 0, sizeof(crocket_sync_state));
+    memset(&crocket_sync_stats, 0, sizeof(crocket_sync_stats));
+    if ((role != CROCKET_SYNC_LEADER) && (role != CROCKET_SYNC_FOLLOWER)) { return 1; }
+
+    // resolve address
+    host = strdup(address ? address : SYNC_DEFAULT_ADDRESS);
+    if (!host) { return 0; }
+    port = strchr(host, ':');
+    if (port) { *port++ = '\0'; }
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (!getaddrinfo(host, port ? port : "1338", &hints, &res) && res) {
+        memcpy(&crocket_sync_address, res->ai_addr, sizeof(crocket_sync_address));
+        ok = 1;
+    }
+    if (res) { freeaddrinfo(res); }
+    free(host);
+    if (!ok) { return 0; }
+
+    // set up socket
+    crocket_sync_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (crocket_sync_socket == INVALID_SOCKET) { return 0; }
+    if (role == CROCKET_SYNC_LEADER) {
+        // make multicast packets visible on this machine and the local network only
+        int ttl = 1;
+        setsockopt(crocket_sync_socket, IPPROTO_IP, IP_MULTICAST_LOOP, (void*)&one, sizeof(one));
+        setsockopt(crocket_sync_socket, IPPROTO_IP, IP_MULTICAST_TTL, (void*)&ttl, sizeof(ttl));
+        crocket_sync_state.session = (unsigned int)(get_monotonic_time() * 1000003.0) ^ (unsigned int)(size_t)&crocket_sync_state;
+        crocket_sync_state.playing = -1;  // force sending a packet in the first update
+    }
+    else {
+        // bind to the port (shared with other followers on the same machine)
+        // and join the multicast group, if any
+        struct sockaddr_in local;
+        int is_multicast = IN_MULTICAST(ntohl(crocket_sync_address.sin_addr.s_addr));
+        setsockopt(crocket_sync_socket, SOL_SOCKET, SO_REUSEADDR, (void*)&one, sizeof(one));
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_port = crocket_sync_address.sin_port;
+        local.sin_addr.s_addr = is_multicast ? htonl(INADDR_ANY) : crocket_sync_address.sin_addr.s_addr;
+        if (bind(crocket_sync_socket, (const struct sockaddr*)&local, sizeof(local))) {
+            sync_close();
+            return 0;
+        }
+        if (is_multicast) {
+            struct ip_mreq mreq;
+            mreq.imr_multiaddr = crocket_sync_address.sin_addr;
+            mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+            if (setsockopt(crocket_sync_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, (void*)&mreq, sizeof(mreq))) {
+                sync_close();
+                return 0;
+            }
+        }
+    }
+    crocket_sync_role = crocket_sync_stats.role = role;
+    return 1;
+}
+
+void crocket_get_sync_stats(crocket_sync_stats_t* stats) {
+    if (!stats) { return; }
+    *stats = crocket_sync_stats;
+    if ((crocket_sync_role == CROCKET_SYNC_FOLLOWER) && crocket_sync_state.have_leader) {
+        stats->age = (float)(get_monotonic_time() - crocket_sync_state.packet_time);
+    }
+}
+
+//! leader: send a packet if the state changed or the last one is too old
+static void sync_lead(float time, int state) {
+    sync_state_t* s = &crocket_sync_state;
+    double now = get_monotonic_time();
+    int playing = (state & CROCKET_STATE_PLAYING) ? 1 : 0;
+    float expected = s->leader_time + (s->playing ? (float)(now - s->packet_time) : 0.0f);
+    sync_packet_t p;
+    union _val { unsigned int i; float f; } value;
+
+    // detect seeks: explicit ones from the editor, and jumps of the application's clock
+    if ((s->playing >= 0)
+    && ((state & CROCKET_EVENT_SEEK) || (((time - expected) > SYNC_JUMP_THRESHOLD) || ((expected - time) > SYNC_JUMP_THRESHOLD)))) {
+        ++s->seeks;
+        ++crocket_sync_stats.seeks;
+    }
+    else if ((playing == s->playing) && ((now - s->packet_time) < SYNC_INTERVAL)) {
+        return;  // nothing to report yet
+    }
+
+    // send packet
+    memcpy(p.signature, SYNC_SIGNATURE, 8);
+    value.f = time;
+    p.session  = htonl(s->session);
+    p.sequence = htonl(++s->sequence);
+    p.seeks    = htonl(s->seeks);
+    p.playing  = htonl(playing);
+    p.time     = htonl(value.i);
+    sendto(crocket_sync_socket, (const char*)&p, sizeof(p), 0,
+           (const struct sockaddr*)&crocket_sync_address, sizeof(crocket_sync_address));
+    s->leader_time = time;
+    s->packet_time = now;
+    s->playing = playing;
+    ++crocket_sync_stats.packets;
+}
+
+//! follower: receive packets and adjust the application time
+static void sync_follow(float *p_time) {
+    sync_state_t* s = &crocket_sync_state;
+    double now = get_monotonic_time();
+    float elapsed = s->update_time ? (float)(now - s->update_time) : 0.0f;
+    float predicted, target, error;
+    int force_seek = 0;
+    sync_packet_t p;
+    s->update_time = now;
+
+    // receive all pending packets, keep the newest one
+    for (;;) {
+        union _val { unsigned int i; float f; } value;
+        unsigned int session, sequence, seeks;
+        int playing;
+        fd_set fds;
+        struct timeval tv = { 0, 0 };
+        FD_ZERO(&fds);
+        FD_SET(crocket_sync_socket, &fds);
+        if ((select((int)crocket_sync_socket + 1, &fds, NULL, NULL, &tv) <= 0)
+        ||  (recv(crocket_sync_socket, (char*)&p, sizeof(p), 0) != sizeof(p))) {
+            break;
+        }
+        if (memcmp(p.signature, SYNC_SIGNATURE, 8)) { continue; }
+        session  = ntohl(p.session);
+        sequence = ntohl(p.sequence);
+        if (s->have_leader && (session == s->session) && ((int)(sequence - s->sequence) <= 0)) {
+            continue;  // outdated packet
+        }
+        seeks   = ntohl(p.seeks);
+        playing = ntohl(p.playing) ? 1 : 0;
+        value.i = ntohl(p.time);
+        ++crocket_sync_stats.packets;
+
+        // state changes of the leader
+        if (!s->have_leader || (session != s->session) || (seeks != s->seeks)) {
+            force_seek = 1;
+        }
+        if (playing && !(crocket_current_state & CROCKET_STATE_PLAYING)) {
+            crocket_current_state = (crocket_current_state | CROCKET_EVENT_PLAY | CROCKET_STATE_PLAYING) & (~CROCKET_EVENT_STOP);
+        }
+        else if (!playing && (crocket_current_state & CROCKET_STATE_PLAYING)) {
+            crocket_current_state = (crocket_current_state | CROCKET_EVENT_STOP) & (~(CROCKET_EVENT_PLAY | CROCKET_STATE_PLAYING));
+            force_seek = 1;  // stop exactly where the leader stopped
+        }
+        s->session = session;
+        s->sequence = sequence;
+        s->seeks = seeks;
+        s->playing = playing;
+        s->leader_time = value.f;
+        s->packet_time = now;
+        s->have_leader = 1;
+    }
+    if (!s->have_leader) { return; }
+
+    // compute where the leader is now, and how far we're off
+    predicted = s->leader_time + (s->playing ? (float)(now - s->packet_time) : 0.0f);
+    target = predicted - *p_time;
+    error = target - s->correction;
+    if (s->seek_pending && !force_seek) {
+        // first update after we signalled a seek: the application may or
+        // may not have followed it, so take its new time as the reference
+        s->correction = target;
+        s->seek_pending = 0;
+    }
+    else if (force_seek || (error > SYNC_JUMP_THRESHOLD) || (error < -SYNC_JUMP_THRESHOLD)) {
+        // too far off, or the leader seeked: jump
+        crocket_current_state |= CROCKET_EVENT_SEEK;
+        ++crocket_sync_stats.seeks;
+        s->correction = target;
+        s->seek_pending = 1;
+        s->last_target_time = 0.0;
+    }
+    else {
+        // slightly off: slew towards the leader's time
+        float max_step = SYNC_SLEW_RATE * elapsed;
+        s->correction += (error > max_step) ? max_step : (error < -max_step) ? -max_step : error;
+
+        // estimate the drift from the change of the required correction
+        if (s->playing && (s->packet_time == now)) {
+            if (s->last_target_time > 0.0) {
+                float drift = (target - s->last_target) / (float)(now - s->last_target_time);
+                crocket_sync_stats.drift += SYNC_DRIFT_SMOOTHING * (drift - crocket_sync_stats.drift);
+            }
+            s->last_target = target;
+            s->last_target_time = now;
+        }
+    }
+    *p_time += s->correction;
+    crocket_sync_stats.offset = target - s->correction;
+    crocket_sync_stats.correction = s->correction;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 ///// CORE API                                                            /////
@@ -423,6 +2291,7 @@ int crocket_init(const char* save_file, const void* track_data, float rpm) {
     // prepare all variables
     crocket_done();
     crocket_timescale = rpm / 60.0f;
+    build_groups();
 #ifndef CROCKET_PLAYER_ONLY
     crocket_current_state = 0;
     crocket_current_row = -1;
@@ -434,7 +2303,28 @@ int crocket_init(const char* save_file, const void* track_data, float rpm) {
     if (host) {
         host = strdup(host);  // we're gonna modify the value, so copy it
     }
-    if (host) {
+    free(crocket_shm_name);
+    crocket_shm_name = NULL;
+    crocket_transport = &socket_transport;
+    if (host && !strncmp(host, "shm:", 4)) {
+        // shared memory transport
+        crocket_shm_name = strdup(&host[4]);
+        crocket_transport = &shm_transport;
+        if (!crocket_shm_name) { crocket_mode = CROCKET_MODE_PLAYER; }
+    }
+    else if (host && !strncmp(host, "unix:", 5)) {
+#ifndef _WIN32
+        // Unix domain socket
+        struct sockaddr_un* addr = (struct sockaddr_un*)&crocket_server_address;
+        memset(&crocket_server_address, 0, sizeof(crocket_server_address));
+        addr->sun_family = AF_UNIX;
+        strncpy(addr->sun_path, &host[5], sizeof(addr->sun_path) - 1);
+        crocket_server_address_len = sizeof(struct sockaddr_un);
+#else
+        crocket_mode = CROCKET_MODE_PLAYER;  // not supported on Windows
+#endif
+    }
+    else if (host) {
         struct addrinfo hints, *res = NULL;
         char *port = strchr(host, ':');
         if (port) { *port++ = '\0'; }
@@ -442,7 +2332,8 @@ int crocket_init(const char* save_file, const void* track_data, float rpm) {
         hints.ai_family = AF_INET;
         hints.ai_socktype = SOCK_STREAM;
         if (!getaddrinfo(host, port ? port : "1338", &hints, &res) && res) {
-            memcpy(&crocket_server_address, res->ai_addr, sizeof(crocket_server_address));
+            memcpy(&crocket_server_address, res->ai_addr, res->ai_addrlen);
+            crocket_server_address_len = (int)res->ai_addrlen;
         }
         else {
             crocket_mode = CROCKET_MODE_PLAYER;  // host not found, can't connect
@@ -451,9 +2342,12 @@ int crocket_init(const char* save_file, const void* track_data, float rpm) {
     }
     else {
         // default address: localhost:1338
-        crocket_server_address.sin_family = AF_INET;
-        crocket_server_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
-        crocket_server_address.sin_port = htons(1338);
+        struct sockaddr_in* addr = (struct sockaddr_in*)&crocket_server_address;
+        memset(&crocket_server_address, 0, sizeof(crocket_server_address));
+        addr->sin_family = AF_INET;
+        addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr->sin_port = htons(1338);
+        crocket_server_address_len = sizeof(struct sockaddr_in);
     }
     free(host);
 
@@ -466,22 +2360,19 @@ int crocket_init(const char* save_file, const void* track_data, float rpm) {
         // load track data from file
         void* loaded_data = NULL;
         if (save_file && save_file[0] && !track_data) {
-            FILE *f = fopen(save_file, "rb");
-            if (f) {
-                size_t s;
-                fseek(f, 0, SEEK_END);
-                s = ftell(f);
-                fseek(f, 0, SEEK_SET);
-                loaded_data = malloc(s);
-                if (loaded_data && (fread(loaded_data, 1, s, f) == s)) {
-                    track_data = loaded_data;
-                }
-            }
+            loaded_data = read_file(save_file);
+            track_data = loaded_data;
         }
 
         // import track data (from file or provided buffer)
+        // (with lazy decoding, the loaded data is kept until crocket_done())
         load_data(track_data);
-        free(loaded_data);        
+        if (crocket_lazy_decode) {
+            crocket_loaded_data = loaded_data;
+        }
+        else {
+            free(loaded_data);
+        }
 #ifndef CROCKET_PLAYER_ONLY
     }
     return crocket_mode;
@@ -497,16 +2388,171 @@ void crocket_done(void) {
     disconnect();
     free(crocket_save_file);
     crocket_save_file = NULL;
+    free(crocket_shm_name);
+    crocket_shm_name = NULL;
+    free(crocket_remote_map);
+    crocket_remote_map = NULL;
+    crocket_nremote = crocket_remote_alloc = 0;
+    free_shadow_tracks();
+    crocket_external_polling = 0;
 #endif // CROCKET_PLAYER_ONLY
+    unpublish();
+    sync_close();
+    detach_all();
+    free_groups();
+    free(crocket_hot_tracks);
+    crocket_hot_tracks = NULL;
+    crocket_nhot = crocket_hot_alloc = 0;
     for (t = crocket_tracks;  t->name;  ++t) {
-        free(t->keys);
-        t->keys = NULL;
-        t->nkeys = t->alloc = 0;
+        free_track_keys(t);
+        t->ctf_keys = NULL;
+        t->active = 0;
+        crocket_classify_track(t);
+    }
+    free_key_memory();
+    free(crocket_loaded_data);
+    crocket_loaded_data = NULL;
+}
+
+#define PREFETCH_DISTANCE 8  //!< number of tracks sample_tracks() prefetches ahead
+
+//! sample a track from its complete data
+//! \returns the number of tracks that have been sampled (all components of
+//!          a vector variable with shared keys, if it ends before 'end')
+static unsigned int sample_track(crocket_track_t* t, const crocket_track_t* end, float row) {
+    if (t->vector && (&t[t->vector] <= end) && is_vector_shared(t)) {
+        float values[4];
+        unsigned int c;
+        sample_shared_vector(t, row, values);
+        for (c = 0;  c < t->vector;  ++c) { *t[c].p_var = values[c]; }
+        return t->vector;
+    }
+    if (t->kind <= CROCKET_TRACK_CONSTANT) {
+        if (t->valid) { return 1; }
+        t->valid = 1;
+    }
+    else if (t->bake_pending) {
+        bake_track(t);
+    }
+    *t->p_var = samplers[t->kind](t, row);
+    return 1;
+}
+
+//! make sure that crocket_hot_tracks covers all tracks
+//! \returns zero if out of memory
+static int grow_hot_tracks(void) {
+    if (crocket_ntracks > crocket_hot_alloc) {
+        unsigned int new_alloc = crocket_hot_alloc ? (crocket_hot_alloc << 1) : 64;
+        hot_track_t* new_hot;
+        while (new_alloc < crocket_ntracks) { new_alloc <<= 1; }
+        new_hot = realloc(crocket_hot_tracks, new_alloc * sizeof(hot_track_t));
+        if (!new_hot) { return 0; }
+        crocket_hot_tracks = new_hot;
+        crocket_hot_alloc = new_alloc;
+    }
+    memset(&crocket_hot_tracks[crocket_nhot], 0, (crocket_ntracks - crocket_nhot) * sizeof(hot_track_t));  // (HOT_STALE)
+    crocket_nhot = crocket_ntracks;
+    return 1;
+}
+
+//! update the copy of a track's data in crocket_hot_tracks
+static void update_hot_track(hot_track_t* h, const crocket_track_t* t) {
+    h->p_var = t->p_var;
+    h->keys = t->keys;
+    h->nkeys = t->nkeys;
+    h->pos = 0;
+    if (t->vector || t->component || (t->kind > CROCKET_TRACK_GENERAL)) {
+        h->kind = HOT_FULL;  // vector variables, baked and undecoded tracks
+    }
+    else if ((t->kind <= CROCKET_TRACK_CONSTANT) ? !t->valid : t->bake_pending) {
+        h->kind = HOT_STALE;  // sample from the track once, then check again
+    }
+    else {
+        h->kind = (t->kind <= CROCKET_TRACK_CONSTANT) ? HOT_DONE : t->kind;
+    }
+}
+
+//! find the key position of a row (like crocket_find_key()) in an array of keys
+static unsigned int search_keys(const crocket_key_t* keys, unsigned int nkeys, unsigned int row) {
+    unsigned int a = 0, b = nkeys, c, pivot;
+    if (row < crocket_key_row(&keys[0])) {
+        return 0;  // before first key
+    }
+    while ((a + 1) < b) {
+        c = (a + b) >> 1;
+        pivot = crocket_key_row(&keys[c]);
+        if (row == pivot) {
+            return c + 1;  // shortcut for exact hit
+        }
+        if (row > pivot) { a = c; }
+                    else { b = c; }
+    }
+    return a + 1;
+}
+
+//! find the key position of a row in a hot track, starting at the position
+//! found by the previous update (usually, the row is still in the same
+//! segment, or has just moved on to the next one)
+static inline unsigned int find_hot_key(hot_track_t* h, unsigned int row) {
+    const crocket_key_t* k = h->keys;
+    unsigned int pos = h->pos;
+    if (pos && (row < crocket_key_row(&k[pos-1]))) {
+        pos = search_keys(k, h->nkeys, row);  // moved backwards
+    }
+    else if ((pos < h->nkeys) && (row >= crocket_key_row(&k[pos]))) {
+        ++pos;
+        if ((pos < h->nkeys) && (row >= crocket_key_row(&k[pos]))) {
+            pos = search_keys(k, h->nkeys, row);  // skipped a segment
+        }
+    }
+    h->pos = pos;
+    return pos;
+}
+
+//! sample a range of tracks into their variables
+static void sample_tracks(unsigned int start, unsigned int end, float row) {
+    const crocket_track_t* t_end = &crocket_tracks[end];
+    unsigned int i = start, irow = (row <= 0.0f) ? 0 : (unsigned int)row;
+    if ((crocket_nhot < end) && !grow_hot_tracks()) {
+        // out of memory: sample everything from the complete tracks
+        while (i < end) { i += sample_track(&crocket_tracks[i], t_end, row); }
+        return;
+    }
+    while (i < end) {
+        hot_track_t* h = &crocket_hot_tracks[i];
+#if defined(__GNUC__) || defined(__clang__)
+        // fetch the keys around the previous position of an upcoming track
+        if (((i + PREFETCH_DISTANCE) < end) && h[PREFETCH_DISTANCE].pos) {
+            __builtin_prefetch(&h[PREFETCH_DISTANCE].keys[h[PREFETCH_DISTANCE].pos - 1]);
+        }
+#endif
+        if (h->kind == HOT_STALE) {
+            update_hot_track(h, &crocket_tracks[i]);
+        }
+        switch (h->kind) {
+            case HOT_DONE:
+                ++i;
+                break;
+            case CROCKET_TRACK_STEP:
+                *h->p_var = step_value(h->keys, find_hot_key(h, irow));
+                ++i;
+                break;
+            case CROCKET_TRACK_LINEAR:
+                *h->p_var = linear_value(h->keys, h->nkeys, find_hot_key(h, irow), row);
+                ++i;
+                break;
+            case CROCKET_TRACK_GENERAL:
+                *h->p_var = general_value(h->keys, h->nkeys, find_hot_key(h, irow), row);
+                ++i;
+                break;
+            default:  // HOT_FULL or HOT_STALE
+                i += sample_track(&crocket_tracks[i], t_end, row);
+                break;
+        }
     }
 }
 
 int crocket_update(float *p_time) {
-    const crocket_track_t* t;
     float row;
     int res;
 
@@ -517,10 +2563,22 @@ int crocket_update(float *p_time) {
     row = *p_time * crocket_timescale;
     if (row < 0.0f) { row = 0.0f; }
 
+    // swap in track data that has been decoded in the background
+    apply_attached_data();
+
 #ifndef CROCKET_PLAYER_ONLY
     // react on network, update state
+    // (unless the application takes care of that with crocket_on_readable())
     reconnect();
-    handle_messages(0);
+    if (!crocket_external_polling) {
+        handle_messages(0);
+    }
+    if (crocket_resync && ((get_monotonic_time() - crocket_resync_time) >= RESYNC_SETTLE_TIME)) {
+        finish_resync();
+    }
+    if (crocket_lazy && crocket_sampled_changed) {
+        activate_sampled_tracks();  // sampled for the first time
+    }
 
     // time update -- make the app time and crocket_current_row consistent
     if (crocket_current_state & CROCKET_EVENT_SEEK) {
@@ -562,20 +2620,136 @@ int crocket_update(float *p_time) {
     }
 #endif // CROCKET_PLAYER_ONLY
 
-    // sample current value for all tracks
+    // clock synchronization between multiple instances
+    if (crocket_sync_role == CROCKET_SYNC_LEADER) {
+        sync_lead(*p_time, crocket_current_state);
+    }
+    else if (crocket_sync_role == CROCKET_SYNC_FOLLOWER) {
+        sync_follow(p_time);
+        row = *p_time * crocket_timescale;
+        if (row < 0.0f) { row = 0.0f; }
+    }
+
+    // sample current value for all tracks of the enabled groups
+    // (constant tracks only need to be written once after every change)
+    if (crocket_grouped_tracks == crocket_ntracks) {
+        const group_run_t* r;
+        for (r = crocket_runs;  r < &crocket_runs[crocket_nruns];  ++r) {
+            if (crocket_groups[r->group].enabled) {
+                sample_tracks(r->start, r->end, row);
+            }
+        }
+    }
+    else {
+        sample_tracks(0, crocket_ntracks, row);  // no group information
+    }
+
+    // done -- return state/event bitmask and clear the event part of it,
+    // now that the events have been delivered to the application
+    res = crocket_current_state;
+    crocket_current_state &= CROCKET_STATE_CONNECTED | CROCKET_STATE_PLAYING;
+    if (crocket_shared) {
+        publish_values(*p_time, row, res);
+    }
+    return res;
+}
+
+int crocket_register_track(const char* name, float* p_var) {
+    crocket_track_t* t;
+    unsigned int len;
+    if (!name || !name[0] || !p_var) { return -1; }
+    len = (unsigned int)strlen(name);
+
+    // already registered? then just update the variable
+    t = find_track_by_name(name, len);
+    if (t) {
+        t->p_var = p_var;
+        t->valid = 0;
+        invalidate_hot_track(t);
+        return (int)(t - crocket_tracks);
+    }
+
+    // make room for the new track and the terminator
+    if ((crocket_ntracks + 2) > crocket_tracks_alloc) {
+        unsigned int new_alloc = crocket_tracks_alloc ? (crocket_tracks_alloc << 1) : 64;
+        crocket_track_t* new_tracks;
+        while (new_alloc < (crocket_ntracks + 2)) { new_alloc <<= 1; }
+        if (crocket_tracks_alloc) {
+            new_tracks = realloc(crocket_tracks, new_alloc * sizeof(crocket_track_t));
+        }
+        else {
+            // first dynamic track: move the static ones into the dynamic table
+            new_tracks = malloc(new_alloc * sizeof(crocket_track_t));
+            if (new_tracks) {
+                memcpy(new_tracks, crocket_static_tracks, (crocket_ntracks + 1) * sizeof(crocket_track_t));
+            }
+        }
+        if (!new_tracks) { return -1; }
+        crocket_tracks = new_tracks;
+        crocket_tracks_alloc = new_alloc;
+        crocket_nhot = 0;  // the inline keys have moved
+        for (t = crocket_tracks;  t->name;  ++t) {
+            if (has_inline_keys(t)) { t->keys = t->inline_keys; }  // the records have moved
+        }
+    }
+
+    // set up the new track
+    t = &crocket_tracks[crocket_ntracks];
+    memset(t, 0, 2 * sizeof(crocket_track_t));  // (including the terminator)
+    t->name = strdup(name);
+    if (!t->name) { return -1; }
+    t->p_var = p_var;
+    t->kind = CROCKET_TRACK_EMPTY;
+    ++crocket_ntracks;
+    if ((crocket_grouped_tracks == (crocket_ntracks - 1)) && crocket_runs && !add_track_to_groups()) {
+        free_groups();  // out of memory: sample all tracks
+    }
+
+    // add it to the name index, growing the index if it gets too full
+    if (crocket_name_index && ((crocket_ntracks * 2) > crocket_name_index_size)) {
+        if (!build_name_index(crocket_name_index_size * 2)) {
+            free(crocket_name_index);  // will be rebuilt on the next lookup
+            crocket_name_index = NULL;
+        }
+    }
+    else if (crocket_name_index) {
+        unsigned int slot = hash_name(name, len);
+        while (crocket_name_index[slot & (crocket_name_index_size - 1)]) { ++slot; }
+        crocket_name_index[slot & (crocket_name_index_size - 1)] = crocket_ntracks;
+    }
+
+    // request the track from the server right away (unless in lazy mode)
+#ifndef CROCKET_PLAYER_ONLY
+    if (!crocket_lazy) {
+        activate_track(t);
+    }
+#endif
+    return (int)(t - crocket_tracks);
+}
+
+void crocket_bake(unsigned int samples_per_row, float max_error, int threads) {
+    crocket_track_t* t;
+    if (samples_per_row > BAKE_MAX_RATE) { samples_per_row = 0; }  // invalid: don't bake
+    crocket_bake_rate = samples_per_row;
+    crocket_bake_max_error = max_error;
     for (t = crocket_tracks;  t->name;  ++t) {
-        *t->p_var = crocket_sample(t, row);
+        crocket_classify_track(t);  // discards old tables, marks tracks as pending
+    }
+    if (samples_per_row && (threads > 0)) {
+        run_parallel(bake_job, (unsigned int)threads, NULL);
     }
-
-    // done -- return state/event bitmask and clear the event part of it,
-    // now that the events have been delivered to the application
-    res = crocket_current_state;
-    crocket_current_state &= CROCKET_STATE_CONNECTED | CROCKET_STATE_PLAYING;
-    return res;
 }
 
 float crocket_get_value(const float* p_var, float time) {
-    return crocket_sample(crocket_find_track(p_var), time * crocket_timescale);
+    crocket_track_t* t = (crocket_track_t*) crocket_find_track(p_var);
+    if (t) { activate_track(t); }  // lazy mode: sampling a track requests it
+    return crocket_sample(t, time * crocket_timescale);
+}
+
+float crocket_get_track_value(unsigned int index, float time) {
+    crocket_track_t* t = (index < crocket_ntracks) ? &crocket_tracks[index] : NULL;
+    if (t) { activate_track(t); }  // lazy mode: sampling a track requests it
+    return crocket_sample(t, time * crocket_timescale);
 }
 
 void crocket_set_mode(int mode) {
@@ -583,8 +2757,12 @@ void crocket_set_mode(int mode) {
     mode = !!mode;
     if (mode == crocket_mode) { return; }
     crocket_mode = mode;
+    if (mode == CROCKET_MODE_CLIENT) {
+        detach_all();  // the server has the data now
+    }
     if (mode == CROCKET_MODE_PLAYER) {
         disconnect();
+        crocket_freeze();
         if (!(crocket_current_state & CROCKET_STATE_PLAYING)) {
             crocket_current_state |= CROCKET_STATE_PLAYING | CROCKET_EVENT_PLAY;
         }
@@ -594,6 +2772,55 @@ void crocket_set_mode(int mode) {
 #endif // CROCKET_PLAYER_ONLY
 }
 
+void crocket_freeze(void) {
+    crocket_track_t* t;
+    crocket_key_t* arena;
+    unsigned int total_keys = 0, pos = 0;
+
+#ifndef CROCKET_PLAYER_ONLY
+    free_shadow_tracks();  // no more resyncs in player mode
+#endif // CROCKET_PLAYER_ONLY
+
+    // move all keys into a new arena of exactly the right size
+    // (except for small tracks, which keep their keys inline)
+    for (t = crocket_tracks;  t->name;  ++t) {
+        if (t->nkeys > CROCKET_INLINE_KEYS) { total_keys += t->nkeys; }
+    }
+    arena = alloc_keys(total_keys);
+    if (!arena && total_keys) { return; }  // out of memory: keep everything as it is
+    for (t = crocket_tracks;  t->name;  ++t) {
+        unsigned int nkeys = t->nkeys;
+        if (has_inline_keys(t)) { continue; }
+        if (nkeys > CROCKET_INLINE_KEYS) {
+            memcpy(&arena[pos], t->keys, nkeys * sizeof(crocket_key_t));
+            free_track_keys(t);
+            t->keys = &arena[pos];
+            t->alloc = nkeys;
+            pos += nkeys;
+        }
+        else {
+            if (nkeys) {
+                memcpy(t->inline_keys, t->keys, nkeys * sizeof(crocket_key_t));
+            }
+            free_track_keys(t);
+            if (nkeys) {
+                t->keys = t->inline_keys;
+                t->alloc = CROCKET_INLINE_KEYS;
+            }
+        }
+        t->nkeys = nkeys;
+    }
+    crocket_nhot = 0;  // the keys have moved
+    free_key_memory();  // the old arena and the pools aren't used any longer
+    crocket_arena = arena;
+    crocket_arena_size = crocket_arena_used = total_keys;
+
+    // build the baked tables right now instead of during the next updates
+    if (crocket_bake_rate) {
+        bake_job(0, 1, NULL);
+    }
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 ///// IMPORT / EXPORT                                                     /////
@@ -631,27 +2858,77 @@ void crocket_set_mode(int mode) {
 //!     - BYTE interpolation mode
 //!
 //! Empty tracks (i.e. tracks without any keys) may be omitted from the file.
+//!
+//! \section ctf_compressed Compressed CTF
+//! Compressed CTF files use the same signature as plain CTF files, but with
+//! version number 2.0. The signature is followed by the quantization step
+//! of the values as a FLOAT (zero if values are stored losslessly), and then
+//! a single range-coded payload that contains the following streams:
+//! - structure: LEB128 number of tracks, and for each track the LEB128 name
+//!   length, the name and the LEB128 number of keys (exactly like in plain
+//!   CTF, again with empty tracks omitted)
+//! - rows: LEB128 row deltas of all keys of all tracks (like in plain CTF)
+//! - modes: interpolation modes of all keys of all tracks, 2 bits each,
+//!   packed into bytes starting at the least significant bits;
+//!   unknown interpolation modes are stored as 0 (step)
+//! - values: if quantized, the difference between a key's quantized value
+//!   (value divided by the quantization step, rounded to the nearest
+//!   integer) and the quantized value of the previous key in the same track,
+//!   as zigzag-coded LEB128 numbers (quantized values are clamped to
+//!   +/- 2^30 steps); if lossless, the bit pattern of a key's
+//!   value XOR'ed with the bit pattern of the previous key in the same track,
+//!   as four bytes, least significant byte first
+//!
+//! The range coder is the adaptive binary coder from LZMA: 11-bit
+//! probabilities with an adaptation shift of 5, and each byte is coded
+//! MSB first using a binary tree of 255 probabilities. Each stream uses
+//! its own set of probabilities (for lossless values, each of the four byte
+//! positions has its own set), all initialized to 1/2.
 
 #define CTF_FILE_HEADER_PART1  "crocket\n"
 #define CTF_FILE_VERSION       1.0f
+#define CTFZ_FILE_VERSION      2.0f
 #define CTF_FILE_HEADER_PART3  "\r\n\0\x1a"
 #define CTF_FILE_HEADER_LENGTH 16
 
 #define MAX_LEB128_SIZE 5  //!< maximum size, in bytes, of a LEB128 value
 
+// probability sets for the streams of compressed CTF files
+#define CTFZ_MODEL_STRUCTURE 0  //!< track names and key counts
+#define CTFZ_MODEL_ROWS      1  //!< row deltas
+#define CTFZ_MODEL_MODES     2  //!< packed interpolation modes
+#define CTFZ_MODEL_QVALUES   3  //!< quantized values
+#define CTFZ_MODEL_VALUES    4  //!< lossless values (four sets, one per byte)
+#define CTFZ_MODEL_COUNT     8
+
+#define RC_TOP        (1u << 24)  //!< range coder normalization threshold
+#define RC_PROB_BITS  11          //!< range coder probability precision
+#define RC_MOVE_BITS  5           //!< range coder adaptation speed
+
+typedef unsigned short rc_model_t[CTFZ_MODEL_COUNT][256];
+
+static void rc_init_models(rc_model_t prob) {
+    int i, j;
+    for (i = 0;  i < CTFZ_MODEL_COUNT;  ++i) {
+        for (j = 0;  j < 256;  ++j) {
+            prob[i][j] = 1 << (RC_PROB_BITS - 1);
+        }
+    }
+}
+
 #ifndef CROCKET_PLAYER_ONLY
 
-inline unsigned char* put_data(unsigned char* pos, const char* data, int size) {
+static inline unsigned char* put_data(unsigned char* pos, const char* data, int size) {
     memcpy(pos, data, size);
     return pos + size;
 }
-inline unsigned char* put_float(unsigned char* pos, float f) {
+static inline unsigned char* put_float(unsigned char* pos, float f) {
     union _val { float f; unsigned char b[4]; } conv;
     conv.f = f;
     memcpy(pos, conv.b, 4);
     return pos + 4;
 }
-inline unsigned char* put_leb128(unsigned char* pos, unsigned int val) {
+static inline unsigned char* put_leb128(unsigned char* pos, unsigned int val) {
     while (val >= 128) {
         *pos++ = ((unsigned char)val & 0x7F) | 0x80;
         val >>= 7;
@@ -660,17 +2937,190 @@ inline unsigned char* put_leb128(unsigned char* pos, unsigned int val) {
     return pos;
 }
 
-void* crocket_get_track_data(int *p_size) {
+//! range encoder state for compressed CTF
+typedef struct _rc_encoder {
+    unsigned char* data;     //!< output buffer (NULL if out of memory)
+    unsigned int size;       //!< number of bytes written so far
+    unsigned int alloc;      //!< capacity of the output buffer
+    unsigned long long low;  //!< lower bound of the current interval
+    unsigned int range;      //!< size of the current interval
+    unsigned int cache_size; //!< number of pending bytes (for carry propagation)
+    unsigned char cache;     //!< first pending byte
+    rc_model_t prob;         //!< adaptive probabilities
+} rc_encoder_t;
+
+static void rc_put_raw(rc_encoder_t* rc, unsigned char b) {
+    if (!rc->data) { return; }
+    if (rc->size >= rc->alloc) {
+        unsigned char* data = realloc(rc->data, rc->alloc <<= 1);
+        if (!data) {
+            free(rc->data); rc->data = NULL; return;  // oops, out of memory
+        }
+        rc->data = data;
+    }
+    rc->data[rc->size++] = b;
+}
+
+static void rc_shift_low(rc_encoder_t* rc) {
+    if (((unsigned int)rc->low < 0xFF000000u) || (rc->low >> 32)) {
+        unsigned char carry = (unsigned char)(rc->low >> 32);
+        unsigned char b = rc->cache;
+        do {
+            rc_put_raw(rc, (unsigned char)(b + carry));
+            b = 0xFF;
+        } while (--rc->cache_size);
+        rc->cache = (unsigned char)(rc->low >> 24);
+    }
+    ++rc->cache_size;
+    rc->low = (rc->low & 0x00FFFFFFu) << 8;
+}
+
+static void rc_put_byte(rc_encoder_t* rc, int model, unsigned int b) {
+    unsigned short* p = rc->prob[model];
+    unsigned int m = 1;
+    int i;
+    for (i = 7;  i >= 0;  --i) {
+        unsigned int bit = (b >> i) & 1;
+        unsigned int bound = (rc->range >> RC_PROB_BITS) * p[m];
+        if (!bit) {
+            rc->range = bound;
+            p[m] += ((1 << RC_PROB_BITS) - p[m]) >> RC_MOVE_BITS;
+        }
+        else {
+            rc->low += bound;
+            rc->range -= bound;
+            p[m] -= p[m] >> RC_MOVE_BITS;
+        }
+        m = (m << 1) | bit;
+        while (rc->range < RC_TOP) {
+            rc->range <<= 8;
+            rc_shift_low(rc);
+        }
+    }
+}
+
+static void rc_put_leb128(rc_encoder_t* rc, int model, unsigned int val) {
+    while (val >= 128) {
+        rc_put_byte(rc, model, (val & 0x7F) | 0x80);
+        val >>= 7;
+    }
+    rc_put_byte(rc, model, val);
+}
+
+static void* save_compressed_tracks(const crocket_track_t* tracks, int *p_size) {
+    const crocket_track_t* t;
+    const crocket_key_t* k;
+    rc_encoder_t* rc;
+    unsigned char header[CTF_FILE_HEADER_LENGTH + 4], *pos;
+    unsigned int i, ref, mode_bits, mode_count;
+    union _val { float f; unsigned int i; } conv;
+    const float precision = crocket_ctf_precision;
+
+    rc = malloc(sizeof(rc_encoder_t));
+    if (!rc) { return NULL; }
+    rc->alloc = 4096;
+    rc->data = malloc(rc->alloc);
+    rc->size = 0;
+    rc->low = 0;
+    rc->range = 0xFFFFFFFFu;
+    rc->cache_size = 1;
+    rc->cache = 0;
+    rc_init_models(rc->prob);
+
+    // generate header (not range-coded)
+    pos = put_data(header, CTF_FILE_HEADER_PART1, 8);
+    pos = put_float(pos, CTFZ_FILE_VERSION);
+    pos = put_data(pos, CTF_FILE_HEADER_PART3, 4);
+    pos = put_float(pos, (precision > 0.0f) ? precision : 0.0f);
+    for (i = 0;  i < (unsigned int)(pos - header);  ++i) {
+        rc_put_raw(rc, header[i]);
+    }
+
+    // structure stream
+    for (ref = 0, t = tracks;  t->name;  ++t) {
+        if (t->nkeys) { ++ref; }
+    }
+    rc_put_leb128(rc, CTFZ_MODEL_STRUCTURE, ref);
+    for (t = tracks;  t->name;  ++t) {
+        if (!t->nkeys) { continue; }
+        ref = (unsigned int)strlen(t->name);
+        rc_put_leb128(rc, CTFZ_MODEL_STRUCTURE, ref);
+        for (i = 0;  i < ref;  ++i) {
+            rc_put_byte(rc, CTFZ_MODEL_STRUCTURE, (unsigned char)t->name[i]);
+        }
+        rc_put_leb128(rc, CTFZ_MODEL_STRUCTURE, t->nkeys);
+    }
+
+    // row stream
+    for (t = tracks;  t->name;  ++t) {
+        for (ref = 0, k = t->keys;  k < &t->keys[t->nkeys];  ++k) {
+            rc_put_leb128(rc, CTFZ_MODEL_ROWS, crocket_key_row(k) - ref);
+            ref = crocket_key_row(k) + 1;
+        }
+    }
+
+    // interpolation mode stream
+    mode_bits = mode_count = 0;
+    for (t = tracks;  t->name;  ++t) {
+        for (k = t->keys;  k < &t->keys[t->nkeys];  ++k) {
+            mode_bits |= crocket_key_interpol(k) << (2 * (mode_count & 3));
+            if (!(++mode_count & 3)) {
+                rc_put_byte(rc, CTFZ_MODEL_MODES, mode_bits);
+                mode_bits = 0;
+            }
+        }
+    }
+    if (mode_count & 3) {
+        rc_put_byte(rc, CTFZ_MODEL_MODES, mode_bits);
+    }
+
+    // value stream
+    for (t = tracks;  t->name;  ++t) {
+        for (ref = 0, k = t->keys;  k < &t->keys[t->nkeys];  ++k) {
+            if (precision > 0.0f) {
+                unsigned int q = (unsigned int)quantize(k->value / precision);
+                unsigned int delta = q - ref;
+                rc_put_leb128(rc, CTFZ_MODEL_QVALUES, (delta << 1) ^ (0u - (delta >> 31)));
+                ref = q;
+            }
+            else {
+                conv.f = k->value;
+                for (i = 0;  i < 4;  ++i) {
+                    rc_put_byte(rc, CTFZ_MODEL_VALUES + i, ((conv.i ^ ref) >> (8 * i)) & 0xFF);
+                }
+                ref = conv.i;
+            }
+        }
+    }
+
+    // flush the range coder
+    for (i = 0;  i < 5;  ++i) {
+        rc_shift_low(rc);
+    }
+
+    // finished
+    pos = rc->data;
+    if (pos && p_size) { *p_size = (int)rc->size; }
+    free(rc);
+    return pos;
+}
+
+void* crocket_save_tracks(const crocket_track_t* tracks, int *p_size) {
     const crocket_track_t* t;
     const crocket_key_t* k;
     void* data;
     unsigned char* pos;
     unsigned int ref, size, key_count;
 
+    if (!tracks) { return NULL; }
+    if (crocket_ctf_format == CROCKET_CTF_COMPRESSED) {
+        return save_compressed_tracks(tracks, p_size);
+    }
+
     // estimate maximum image size and count tracks
     size = CTF_FILE_HEADER_LENGTH + MAX_LEB128_SIZE;
     ref = 0;
-    for (t = crocket_tracks;  t->name;  ++t) {
+    for (t = tracks;  t->name;  ++t) {
         size += (unsigned int)strlen(t->name) + 2 * MAX_LEB128_SIZE + t->nkeys * (MAX_LEB128_SIZE + 5);
         if (t->nkeys) { ++ref; }
     }
@@ -687,7 +3137,7 @@ void* crocket_get_track_data(int *p_size) {
     pos = put_leb128(pos, ref);
 
     // dump tracks
-    for (t = crocket_tracks;  t->name;  ++t) {
+    for (t = tracks;  t->name;  ++t) {
         key_count = t->nkeys;
         if (!key_count) { continue; }
         ref = (unsigned int)strlen(t->name);
@@ -696,10 +3146,10 @@ void* crocket_get_track_data(int *p_size) {
         pos = put_leb128(pos, key_count);
         ref = 0;
         for (k = t->keys;  key_count;  ++k, --key_count) {
-            pos = put_leb128(pos, k->row - ref);
+            pos = put_leb128(pos, crocket_key_row(k) - ref);
             pos = put_float(pos, k->value);
-            *pos++ = k->interpol;
-            ref = k->row + 1;
+            *pos++ = (unsigned char)crocket_key_interpol(k);
+            ref = crocket_key_row(k) + 1;
         }
     }
 
@@ -709,18 +3159,39 @@ void* crocket_get_track_data(int *p_size) {
     return data;
 }
 
+void* crocket_get_track_data(int *p_size) {
+    crocket_prefetch(NULL);
+    return crocket_save_tracks(crocket_tracks, p_size);
+}
+
+void crocket_set_ctf_format(int format, float precision) {
+    crocket_ctf_format = format;
+    crocket_ctf_precision = precision;
+}
+
 #else // CROCKET_PLAYER_ONLY
 
-void* crocket_get_data(int *p_size) {
+void* crocket_save_tracks(const crocket_track_t* tracks, int *p_size) {
+    (void) tracks;
+    if (p_size) { *p_size = 0; }
+    return NULL;
+}
+
+void* crocket_get_track_data(int *p_size) {
     if (p_size) { *p_size = 0; }
     return NULL;
 }
 
+void crocket_set_ctf_format(int format, float precision) {
+    (void) format;
+    (void) precision;
+}
+
 #endif // CROCKET_PLAYER_ONLY
 
 //--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//
 
-inline const unsigned char* get_leb128(const unsigned char* pos, unsigned int *p_val) {
+static inline const unsigned char* get_leb128(const unsigned char* pos, unsigned int *p_val) {
     unsigned int val = 0, shift = 0;
     for (shift = 0;  shift < 32;  shift += 7) {
         val |= (pos[0] & 0x7F) << shift;
@@ -730,56 +3201,641 @@ inline const unsigned char* get_leb128(const unsigned char* pos, unsigned int *p
     return pos;
 }
 
-static void load_data(const unsigned char* pos) {
+//! callback that decides where the loader shall store the keys of a track
+//! \param ctx    context pointer passed through by the loader
+//! \param name   name of the track (not null-terminated)
+//! \param len    length of the track name
+//! \param count  total number of tracks in the file
+//! \returns the track to load the keys into, or NULL to skip the track
+typedef crocket_track_t* (*track_lookup_t)(void* ctx, const char* name, unsigned int len, unsigned int count);
+
+//! track lookup for the main track list: find the track by name
+static crocket_track_t* lookup_registered_track(void* ctx, const char* name, unsigned int len, unsigned int count) {
+    (void) ctx;
+    (void) count;
+    return find_track_by_name(name, len);
+}
+
+//! state of crocket_load_tracks()
+typedef struct _standalone_tracks {
+    crocket_track_t* tracks;  //!< track list (allocated on first lookup)
+    unsigned int count;       //!< number of tracks in the list
+} standalone_tracks_t;
+
+//! track lookup for standalone track lists: append a new track
+static crocket_track_t* lookup_standalone_track(void* ctx, const char* name, unsigned int len, unsigned int count) {
+    standalone_tracks_t* st = ctx;
     crocket_track_t* t;
+    char* name_copy;
+    if (!st->tracks) {
+        st->tracks = calloc(count + 1, sizeof(crocket_track_t));
+        if (!st->tracks) { return NULL; }
+    }
+    name_copy = malloc(len + 1);
+    if (!name_copy) { return NULL; }
+    memcpy(name_copy, name, len);
+    name_copy[len] = '\0';
+    t = &st->tracks[st->count++];
+    t->name = name_copy;
+    return t;
+}
+
+//! range decoder state for compressed CTF
+typedef struct _rc_decoder {
+    const unsigned char* pos;  //!< input data pointer
+    unsigned int range;        //!< size of the current interval
+    unsigned int code;         //!< current code value, relative to the interval
+    rc_model_t prob;           //!< adaptive probabilities
+} rc_decoder_t;
+
+static unsigned int rc_get_byte(rc_decoder_t* rc, int model) {
+    unsigned short* p = rc->prob[model];
+    unsigned int m = 1;
+    while (m < 256) {
+        unsigned int bound;
+        if (rc->range < RC_TOP) {
+            rc->range <<= 8;
+            rc->code = (rc->code << 8) | *rc->pos++;
+        }
+        bound = (rc->range >> RC_PROB_BITS) * p[m];
+        if (rc->code < bound) {
+            rc->range = bound;
+            p[m] += ((1 << RC_PROB_BITS) - p[m]) >> RC_MOVE_BITS;
+            m <<= 1;
+        }
+        else {
+            rc->code -= bound;
+            rc->range -= bound;
+            p[m] -= p[m] >> RC_MOVE_BITS;
+            m = (m << 1) | 1;
+        }
+    }
+    return m & 0xFF;
+}
+
+static unsigned int rc_get_leb128(rc_decoder_t* rc, int model) {
+    unsigned int val = 0, shift, b;
+    for (shift = 0;  shift < 32;  shift += 7) {
+        b = rc_get_byte(rc, model);
+        val |= (b & 0x7F) << shift;
+        if (!(b & 0x80)) { break; }
+    }
+    return val;
+}
+
+static void load_compressed_data(const unsigned char* pos, track_lookup_t lookup, void* ctx) {
+    struct _ctfz_track {
+        crocket_track_t* t;  //!< target track (NULL if unknown)
+        unsigned int nkeys;  //!< number of keys in the file
+    } *tracks;
+    rc_decoder_t rc;
+    union _val { float f; unsigned int i; } conv;
+    char* name = NULL;
+    unsigned int track_count, i, j, len, ref, mode_bits = 0, mode_count = 0, total_keys = 0;
+    float precision;
+
+    // set up the range decoder
+    memcpy(&precision, pos, 4);
+    rc.pos = pos + 4;
+    rc.range = 0xFFFFFFFFu;
+    rc.code = 0;
+    for (i = 0;  i < 5;  ++i) {
+        rc.code = (rc.code << 8) | *rc.pos++;
+    }
+    rc_init_models(rc.prob);
+
+    // structure stream: find tracks and allocate memory for keys
+    track_count = rc_get_leb128(&rc, CTFZ_MODEL_STRUCTURE);
+    tracks = malloc(track_count * sizeof(*tracks));
+    if (!tracks) { return; }
+    for (i = 0;  i < track_count;  ++i) {
+        crocket_track_t* t;
+        len = rc_get_leb128(&rc, CTFZ_MODEL_STRUCTURE);
+        free(name);
+        name = malloc(len + 1);
+        for (j = 0;  j < len;  ++j) {
+            unsigned int c = rc_get_byte(&rc, CTFZ_MODEL_STRUCTURE);
+            if (name) { name[j] = (char)c; }
+        }
+        t = name ? lookup(ctx, name, len, track_count) : NULL;
+        tracks[i].nkeys = len = rc_get_leb128(&rc, CTFZ_MODEL_STRUCTURE);
+        tracks[i].t = len ? t : NULL;
+        if (t && (len > CROCKET_INLINE_KEYS)) { total_keys += len; }
+    }
+    free(name);
+
+    // allocate memory for the keys (all at once in arena mode)
+    if (lookup == lookup_registered_track) {
+        reserve_arena(total_keys);
+    }
+    for (i = 0;  i < track_count;  ++i) {
+        crocket_track_t* t = tracks[i].t;
+        if (!t) { continue; }
+        if (!alloc_loaded_keys(t, tracks[i].nkeys)) { tracks[i].t = NULL; }
+    }
+
+    // row stream
+    for (i = 0;  i < track_count;  ++i) {
+        for (ref = j = 0;  j < tracks[i].nkeys;  ++j) {
+            ref += rc_get_leb128(&rc, CTFZ_MODEL_ROWS);
+            if (tracks[i].t) { crocket_key_set_row(&tracks[i].t->keys[j], ref, 0); }
+            ++ref;
+        }
+    }
+
+    // interpolation mode stream
+    for (i = 0;  i < track_count;  ++i) {
+        for (j = 0;  j < tracks[i].nkeys;  ++j) {
+            if (!(mode_count++ & 3)) {
+                mode_bits = rc_get_byte(&rc, CTFZ_MODEL_MODES);
+            }
+            if (tracks[i].t) { tracks[i].t->keys[j].row_mode |= (mode_bits & 3) << CROCKET_KEY_MODE_SHIFT; }
+            mode_bits >>= 2;
+        }
+    }
+
+    // value stream
+    for (i = 0;  i < track_count;  ++i) {
+        for (ref = j = 0;  j < tracks[i].nkeys;  ++j) {
+            if (precision > 0.0f) {
+                unsigned int delta = rc_get_leb128(&rc, CTFZ_MODEL_QVALUES);
+                ref += (delta >> 1) ^ (0u - (delta & 1));
+                conv.f = (float)(int)ref * precision;
+            }
+            else {
+                unsigned int b;
+                for (conv.i = b = 0;  b < 4;  ++b) {
+                    conv.i |= rc_get_byte(&rc, CTFZ_MODEL_VALUES + b) << (8 * b);
+                }
+                ref = conv.i ^= ref;
+            }
+            if (tracks[i].t) { tracks[i].t->keys[j].value = conv.f; }
+        }
+        crocket_classify_track(tracks[i].t);
+    }
+    free(tracks);
+}
+
+//! read a whole file into memory
+//! \returns a buffer (to be freed by the caller), or NULL on error
+static void* read_file(const char* filename) {
+    FILE *f = fopen(filename, "rb");
+    void* data = NULL;
+    long size;
+    if (!f) { return NULL; }
+    if (!fseek(f, 0, SEEK_END) && ((size = ftell(f)) > 0) && !fseek(f, 0, SEEK_SET)) {
+        data = malloc((size_t)size);
+        if (data && (fread(data, 1, (size_t)size, f) != (size_t)size)) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(f);
+    return data;
+}
+
+//! decode the keys of a single track from plain CTF data
+//! \param t    track to load the keys into, or NULL to skip the keys
+//! \param pos  position of the track's key count in the CTF data
+//! \returns the position after the track's keys
+static const unsigned char* decode_keys(crocket_track_t* t, const unsigned char* pos) {
     crocket_key_t *k, dummy_key;  // dummy key to read data into for unknown tracks
-    unsigned int track_count, len, row;
-    const float version = CTF_FILE_VERSION;
+    unsigned int len, row, delta;
+
+    // read track length, allocate memory for keys
+    pos = get_leb128(pos, &len);
+    k = NULL;
+    if (t) {
+        k = alloc_loaded_keys(t, len);
+    }
+    if (!k) {
+        crocket_classify_track(t);  // (empty track)
+        t = NULL;
+        k = &dummy_key;
+    }
+
+    // read and decode key data
+    // (for unknown tracks, this only reads into dummy_key)
+    row = 0;
+    while (len--) {
+        pos = get_leb128(pos, &delta);
+        memcpy(&k->value, pos, 4); pos += 4;
+        row += delta;
+        crocket_key_set_row(k, row, *pos++);
+        if (!t) { continue; }
+        row = crocket_key_row(k) + 1;
+        ++k;
+    }
+    crocket_classify_track(t);
+    return pos;
+}
+
+//! decode the keys of a track that has been loaded lazily
+static void decode_track(crocket_track_t* t) {
+    const unsigned char* pos = t->ctf_keys;
+    t->ctf_keys = NULL;
+    decode_keys(t, pos);
+}
+
+unsigned int crocket_prefetch(const char* prefix) {
+    size_t len = prefix ? strlen(prefix) : 0;
+    crocket_track_t* t;
+    unsigned int count = 0;
+    for (t = crocket_tracks;  t->name;  ++t) {
+        if (t->ctf_keys && !strncmp(t->name, prefix ? prefix : "", len)) {
+            decode_track(t);
+            ++count;
+        }
+    }
+    return count;
+}
+
+void crocket_set_lazy_decode(int enable) {
+    crocket_lazy_decode = enable;
+}
+
+//! decode CTF data (plain or compressed)
+//! \param lazy  nonzero to only record the position of each track's keys
+//!              in plain CTF data instead of decoding them
+//! \returns zero if the data is not a CTF file
+static int decode_tracks(const unsigned char* pos, track_lookup_t lookup, void* ctx, int lazy) {
+    crocket_track_t* t;
+    unsigned int track_count, i, len;
+    const float version = CTF_FILE_VERSION, version_z = CTFZ_FILE_VERSION;
 
     // check header
-    if (!pos) { return; }
+    if (!pos) { return 0; }
     if (memcmp(&pos[ 0], CTF_FILE_HEADER_PART1, 8)
-    ||  memcmp(&pos[ 8], &version, 4)
     ||  memcmp(&pos[12], CTF_FILE_HEADER_PART3, 4)) {
-        return;
+        return 0;
+    }
+    if (!memcmp(&pos[8], &version_z, 4)) {
+        load_compressed_data(&pos[16], lookup, ctx);
+        return 1;
+    }
+    if (memcmp(&pos[8], &version, 4)) {
+        return 0;
     }
     pos += 16;
 
+    // arena mode: count the keys first, so they can be allocated at once
+    if ((lookup == lookup_registered_track) && crocket_arena_mode) {
+        const unsigned char* scan = get_leb128(pos, &track_count);
+        unsigned int total_keys = 0;
+        for (i = 0;  i < track_count;  ++i) {
+            scan = get_leb128(scan, &len);
+            t = lookup(ctx, (const char*)scan, len, track_count);
+            scan += len;
+            get_leb128(scan, &len);
+            if (t && (len > CROCKET_INLINE_KEYS)) { total_keys += len; }
+            scan = decode_keys(NULL, scan);
+        }
+        reserve_arena(total_keys);
+    }
+
     // iterate over tracks
-    for (pos = get_leb128(pos, &track_count);  track_count;  --track_count) {
-        // search for the proper track (or sentinel track at end of list if not found)
+    pos = get_leb128(pos, &track_count);
+    for (i = 0;  i < track_count;  ++i) {
+        // search for the proper track (NULL if not found)
         pos = get_leb128(pos, &len);
-        for (t = crocket_tracks;  t->name;  ++t) {
-            if ((strlen(t->name) == len) && !memcmp(t->name, pos, len))
-                { break; }
-        }
+        t = lookup(ctx, (const char*)pos, len, track_count);
         pos += len;
 
-        // read track length, allocate memory for keys
-        pos = get_leb128(pos, &len);
-        t->nkeys = len;
-        if (!len) { continue; }
-        if (t->name) {
-            free(t->keys);
-            t->keys = k = malloc(len * sizeof(crocket_key_t));
-            t->alloc = len;
-            if (!k) { t->nkeys = t->alloc = 0; k = &dummy_key; }
+        // decode the keys, or just skip them and decode them on first use
+        if (t && lazy) {
+            free_track_keys(t);
+            crocket_classify_track(t);
+            t->ctf_keys = pos;
+            t->kind = CROCKET_TRACK_UNDECODED;
+            t = NULL;
         }
-        else {
-            k = &dummy_key;
+        pos = decode_keys(t, pos);
+    }
+    return 1;
+}
+
+static void load_data(const unsigned char* pos) {
+    decode_tracks(pos, lookup_registered_track, NULL, crocket_lazy_decode);
+}
+
+crocket_track_t* crocket_load_tracks(const void* track_data) {
+    standalone_tracks_t st = { NULL, 0 };
+    if (!decode_tracks(track_data, lookup_standalone_track, &st, 0)) {
+        return NULL;
+    }
+    if (!st.tracks) {
+        st.tracks = calloc(1, sizeof(crocket_track_t));  // file without tracks
+    }
+    return st.tracks;
+}
+
+void crocket_free_tracks(crocket_track_t* tracks) {
+    crocket_track_t* t;
+    if (!tracks) { return; }
+    for (t = tracks;  t->name;  ++t) {
+        free_track_keys(t);
+        free(t->table);
+        free((void*)t->name);
+    }
+    free(tracks);
+}
+
+//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//
+
+//! additional track data source that is decoded in the background
+//! (see crocket_attach())
+typedef struct _attach_job {
+    struct _attach_job* next;
+    char* prefix;               //!< name prefix of the tracks to load
+    char** excluded;            //!< prefixes of tracks that shall not be applied any longer
+    unsigned int nexcluded;     //!< number of entries in 'excluded'
+    char* filename;             //!< file to load the data from, or NULL
+    const void* track_data;     //!< track data (if filename is NULL)
+    standalone_tracks_t result; //!< decoded tracks
+    volatile int finished;      //!< set by the worker thread when it's done
+    int cancelled;              //!< nonzero if the result shall be discarded
+    int threaded;               //!< nonzero if 'thread' is valid
+    thread_t thread;            //!< worker thread
+} attach_job_t;
+
+attach_job_t* crocket_attach_jobs = NULL;  //!< pending jobs, oldest first
+
+//! track lookup for attached data: only load tracks with the job's prefix
+static crocket_track_t* lookup_attached_track(void* ctx, const char* name, unsigned int len, unsigned int count) {
+    attach_job_t* job = ctx;
+    size_t plen = strlen(job->prefix);
+    if ((len < plen) || memcmp(name, job->prefix, plen)) { return NULL; }
+    return lookup_standalone_track(&job->result, name, len, count);
+}
+
+//! worker thread for crocket_attach(): load and decode the data
+#ifdef _WIN32
+static DWORD WINAPI attach_worker(LPVOID arg) {
+#else
+static void* attach_worker(void* arg) {
+#endif
+    attach_job_t* job = arg;
+    void* loaded_data = job->filename ? read_file(job->filename) : NULL;
+    decode_tracks(job->filename ? loaded_data : job->track_data, lookup_attached_track, job, 0);
+    free(loaded_data);
+    MEMORY_BARRIER();
+    job->finished = 1;
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+//! wait for a job's worker thread to finish
+static void join_attach_job(attach_job_t* job) {
+    if (job->threaded) {
+#ifdef _WIN32
+        WaitForSingleObject(job->thread, INFINITE);
+        CloseHandle(job->thread);
+#else
+        pthread_join(job->thread, NULL);
+#endif
+        job->threaded = 0;
+    }
+}
+
+//! wait for a job's worker thread and free the job and its result
+static void free_attach_job(attach_job_t* job) {
+    unsigned int i;
+    join_attach_job(job);
+    crocket_free_tracks(job->result.tracks);
+    for (i = 0;  i < job->nexcluded;  ++i) {
+        free(job->excluded[i]);
+    }
+    free(job->excluded);
+    free(job->prefix);
+    free(job->filename);
+    free(job);
+}
+
+//! cancel all pending jobs for tracks with a specific name prefix
+//! \note Jobs for a shorter prefix (e.g. "" when cancelling "scene1:") keep
+//!       running, but won't apply the keys of the matching tracks.
+static void cancel_attach_jobs(const char* prefix) {
+    attach_job_t* job;
+    size_t len = strlen(prefix);
+    for (job = crocket_attach_jobs;  job;  job = job->next) {
+        char** new_excluded;
+        if (job->cancelled) { continue; }
+        if (!strncmp(job->prefix, prefix, len)) {
+            job->cancelled = 1;  // all of the job's tracks are affected
+            continue;
+        }
+        if (strncmp(prefix, job->prefix, strlen(job->prefix))) {
+            continue;  // no common tracks
+        }
+        new_excluded = realloc(job->excluded, (job->nexcluded + 1) * sizeof(char*));
+        if (new_excluded) {
+            job->excluded = new_excluded;
+            job->excluded[job->nexcluded] = strdup(prefix);
+        }
+        if (!new_excluded || !job->excluded[job->nexcluded]) {
+            job->cancelled = 1;  // out of memory: better drop too much than too little
+            continue;
+        }
+        ++job->nexcluded;
+    }
+}
+
+//! check whether a track of an attach job has been cancelled
+static int is_excluded(const attach_job_t* job, const char* name) {
+    unsigned int i;
+    for (i = 0;  i < job->nexcluded;  ++i) {
+        if (!strncmp(name, job->excluded[i], strlen(job->excluded[i]))) { return 1; }
+    }
+    return 0;
+}
+
+int crocket_attach(const char* prefix, const char* filename, const void* track_data) {
+    attach_job_t *job, **p_tail;
+#ifndef CROCKET_PLAYER_ONLY
+    if (crocket_mode == CROCKET_MODE_CLIENT) { return 0; }  // the server has the data
+#endif
+    if (!prefix) { prefix = ""; }
+    if (!track_data && !(filename && filename[0])) { return 0; }
+    job = calloc(1, sizeof(attach_job_t));
+    if (!job) { return 0; }
+    job->prefix = strdup(prefix);
+    job->filename = track_data ? NULL : strdup(filename);
+    job->track_data = track_data;
+    if (!job->prefix || (!track_data && !job->filename)) {
+        free(job->prefix);
+        free(job->filename);
+        free(job);
+        return 0;
+    }
+#ifdef _WIN32
+    job->thread = CreateThread(NULL, 0, attach_worker, job, 0, NULL);
+    job->threaded = (job->thread != NULL);
+#else
+    job->threaded = !pthread_create(&job->thread, NULL, attach_worker, job);
+#endif
+    if (!job->threaded) {
+        attach_worker(job);  // no thread: decode right here
+    }
+    // older jobs for the same tracks are superseded by this one
+    cancel_attach_jobs(prefix);
+    for (p_tail = &crocket_attach_jobs;  *p_tail;  p_tail = &(*p_tail)->next);
+    *p_tail = job;
+    return 1;
+}
+
+unsigned int crocket_detach(const char* prefix) {
+    crocket_track_t* t;
+    size_t len;
+    unsigned int count = 0;
+    if (!prefix) { prefix = ""; }
+    len = strlen(prefix);
+    cancel_attach_jobs(prefix);
+    for (t = crocket_tracks;  t->name;  ++t) {
+        if (strncmp(t->name, prefix, len) || (!t->nkeys && !t->ctf_keys)) { continue; }
+        free_track_keys(t);
+        t->ctf_keys = NULL;
+        crocket_classify_track(t);
+        ++count;
+    }
+    return count;
+}
+
+unsigned int crocket_attach_pending(void) {
+    const attach_job_t* job;
+    unsigned int count = 0;
+    for (job = crocket_attach_jobs;  job;  job = job->next) {
+        if (!job->cancelled) { ++count; }
+    }
+    return count;
+}
+
+//! move the keys of all finished jobs into the tracks
+static void apply_attached_data(void) {
+    attach_job_t *job, **p_job = &crocket_attach_jobs;
+    while ((job = *p_job) != NULL) {
+        crocket_track_t *src, *t;
+        if (!job->finished) {
+            p_job = &job->next;
+            continue;
+        }
+        join_attach_job(job);  // (returns immediately)
+        *p_job = job->next;
+        for (src = job->result.tracks;  !job->cancelled && src && src->name;  ++src) {
+            if (is_excluded(job, src->name)) { continue; }
+            t = find_track_by_name(src->name, (unsigned int)strlen(src->name));
+            if (!t) { continue; }
+            free_track_keys(t);
+            if (has_inline_keys(src)) {
+                memcpy(t->inline_keys, src->inline_keys, sizeof(t->inline_keys));
+                t->keys = t->inline_keys;
+            }
+            else {
+                t->keys = src->keys;
+            }
+            t->nkeys = src->nkeys;
+            t->alloc = src->alloc;
+            t->ctf_keys = NULL;
+            src->keys = NULL;
+            src->nkeys = src->alloc = 0;
+            crocket_classify_track(t);
         }
+        free_attach_job(job);
+    }
+}
+
+//! cancel all jobs and wait until they are finished
+static void detach_all(void) {
+    while (crocket_attach_jobs) {
+        attach_job_t* job = crocket_attach_jobs;
+        crocket_attach_jobs = job->next;
+        free_attach_job(job);
+    }
+}
+
+//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//--//
 
-        // read and decode key data
-        // (for unknown tracks, this only reads into dummy_key)
-        row = 0;
-        while (len--) {
-            pos = get_leb128(pos, &k->row);
-            memcpy(&k->value, pos, 4); pos += 4;
-            k->interpol = *pos++;
-            if (!t->name) { continue; }
-            k->row += row;
-            row = k->row + 1;
-            ++k;
+#define VALUE_TABLE_ALIGN 64  //!< alignment of the value data in a value table
+
+//! state of a value table export job
+typedef struct _value_table_job {
+    const crocket_track_t* tracks;  //!< tracks to sample
+    const crocket_value_table_t* header;
+    float* data;                    //!< value data
+    float timescale;                //!< seconds-to-rows conversion factor
+} value_table_job_t;
+
+//! value table export job for run_parallel(): sample a contiguous range of frames
+static void value_table_job(unsigned int index, unsigned int count, void* ctx) {
+    const value_table_job_t* job = ctx;
+    const crocket_value_table_t* h = job->header;
+    unsigned int f = (unsigned int)(((unsigned long long)h->nframes * index) / count);
+    unsigned int f_end = (unsigned int)(((unsigned long long)h->nframes * (index + 1)) / count);
+    for (;  f < f_end;  ++f) {
+        float row = (h->start + (float)f / h->fps) * job->timescale;
+        unsigned int i;
+        if (row < 0.0f) { row = 0.0f; }
+        for (i = 0;  i < h->ntracks;  ++i) {
+            job->data[(h->layout == CROCKET_TABLE_ROW_MAJOR) ? (f * h->ntracks + i) : (i * h->nframes + f)]
+                = crocket_sample(&job->tracks[i], row);
         }
     }
 }
+
+void* crocket_make_value_table(const crocket_track_t* tracks, float timescale, float fps, float start, float end, int layout, int threads, int *p_size) {
+    crocket_value_table_t* h;
+    value_table_job_t job;
+    const crocket_track_t* t;
+    unsigned int ntracks_out = 0, names_size = 0, nframes;
+    unsigned long long size;
+    char* names;
+
+    // compute the table geometry
+    if (!tracks || !(fps > 0.0f) || !(end > start)) { return NULL; }
+    nframes = (unsigned int)((end - start) * fps);
+    if ((start + (float)nframes / fps) < end) { ++nframes; }
+    for (t = tracks;  t->name;  ++t) {
+        names_size += (unsigned int)strlen(t->name) + 1;
+        ++ntracks_out;
+        if (t->ctf_keys) { decode_track((crocket_track_t*)t); }  // (not in the worker threads)
+    }
+    size = sizeof(crocket_value_table_t) + names_size + VALUE_TABLE_ALIGN - 1;
+    size -= size % VALUE_TABLE_ALIGN;
+    size += (unsigned long long)nframes * ntracks_out * sizeof(float);
+    if (size > 0x7FFFFFFFull) { return NULL; }  // too large
+
+    // set up header and name table
+    h = calloc(1, (size_t)size);
+    if (!h) { return NULL; }
+    memcpy(h->signature, CROCKET_VALUE_TABLE_SIGNATURE, 8);
+    h->version = CROCKET_VALUE_TABLE_VERSION;
+    h->layout = (layout == CROCKET_TABLE_COLUMN_MAJOR) ? CROCKET_TABLE_COLUMN_MAJOR : CROCKET_TABLE_ROW_MAJOR;
+    h->nframes = nframes;
+    h->ntracks = ntracks_out;
+    h->fps = fps;
+    h->start = start;
+    h->names_offset = sizeof(crocket_value_table_t);
+    h->data_offset = (unsigned int)(size - (unsigned long long)nframes * ntracks_out * sizeof(float));
+    names = (char*)h + h->names_offset;
+    for (t = tracks;  t->name;  ++t) {
+        size_t len = strlen(t->name) + 1;
+        memcpy(names, t->name, len);
+        names += len;
+    }
+
+    // sample all tracks
+    job.tracks = tracks;
+    job.header = h;
+    job.data = (float*)((char*)h + h->data_offset);
+    job.timescale = timescale;
+    run_parallel(value_table_job, (threads > 0) ? (unsigned int)threads : cpu_count(), &job);
+
+    if (p_size) { *p_size = (int)size; }
+    return h;
+}
+
+void* crocket_get_value_table(float fps, float start, float end, int layout, int threads, int *p_size) {
+    return crocket_make_value_table(crocket_tracks, crocket_timescale, fps, start, end, layout, threads, p_size);
+}
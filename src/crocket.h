@@ -24,14 +24,20 @@
 #ifndef _CROCKET_H_
 #define _CROCKET_H_
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // add definitions for the managed variables
 #define var(s,n) extern float s;
+#define var3(s,n) extern float s[3];
+#define var4(s,n) extern float s[4];
 #include "crocket_vars.h"
 #undef var
+#undef var3
+#undef var4
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -91,12 +97,189 @@ extern int crocket_update(float *p_time);
 //! \returns the requested value
 extern float crocket_get_value(const float* p_var, float time);
 
+//! bake tracks into uniformly spaced lookup tables for constant-time sampling
+//! \param samples_per_row  resolution of the tables (at most 256);
+//!                         0 (or a larger value) disables baking
+//! \param max_error        maximum allowed deviation of a table from the exact
+//!                         curve (checked at the center of each table cell);
+//!                         tracks whose table exceeds it are sampled exactly
+//! \param threads          number of threads to bake all tracks right away;
+//!                         if 0, each track is baked on its first update
+//! \note Step edges stay exact. Tables are rebuilt after every change of
+//!       their track, so this is mostly useful in player mode. Sparse tracks
+//!       whose table would need more than 256 cells per key (or more than
+//!       2^20 cells in total) are sampled exactly as well.
+extern void crocket_bake(unsigned int samples_per_row, float max_error, int threads);
+
+//! sample all tracks at a fixed frame rate into a value table
+//! (e.g. to distribute pre-computed values to render farm nodes)
+//! \param fps      frame rate of the table
+//! \param start    time of the first frame (in seconds or rows)
+//! \param end      end of the time range (exclusive)
+//! \param layout   CROCKET_TABLE_ROW_MAJOR to store the values of each frame
+//!                 contiguously, CROCKET_TABLE_COLUMN_MAJOR to store the
+//!                 values of each track contiguously
+//! \param threads  number of threads to use; 0 = one per CPU core
+//! \param p_size   pointer to a variable that shall receive the size,
+//!                 in bytes, of the produced table
+//! \returns a pointer to the table (see crocket_value_table_t),
+//!          to be free()'d by the application
+extern void* crocket_get_value_table(float fps, float start, float end, int layout, int threads, int *p_size);
+// possible layouts for crocket_get_value_table():
+#define CROCKET_TABLE_ROW_MAJOR    0  //!< data[frame][track]
+#define CROCKET_TABLE_COLUMN_MAJOR 1  //!< data[track][frame]
+
+//! publish the current values of all variables in a shared memory segment
+//! for other processes on the same machine (see crocket_shared_values_t)
+//! \param name  name of the shared memory segment (POSIX shared memory
+//!              object or Win32 file mapping); NULL to stop publishing
+//! \returns nonzero if successful
+//! \note The segment is updated at the end of every crocket_update() and
+//!       removed in crocket_done().
+extern int crocket_publish(const char* name);
+
+//! synchronize playback across multiple machines
+//! \param role     CROCKET_SYNC_LEADER to broadcast this instance's time and
+//!                 play state, CROCKET_SYNC_FOLLOWER to follow a leader,
+//!                 or CROCKET_SYNC_OFF to stop synchronization
+//! \param address  UDP destination "HOST:PORT" (a multicast group, or a
+//!                 unicast address for a single follower); NULL for the
+//!                 default "239.255.13.38:1338"
+//! \returns nonzero if successful
+//! \note Followers replace the time passed to crocket_update() by the
+//!       leader's time. Small deviations are corrected smoothly by slewing;
+//!       large ones (and seeks on the leader) result in CROCKET_EVENT_SEEK,
+//!       and changes of the leader's play state are signalled with
+//!       CROCKET_EVENT_PLAY and CROCKET_EVENT_STOP, just like in client mode.
+//!       Synchronization is stopped in crocket_done().
+extern int crocket_sync(int role, const char* address);
+// possible roles for crocket_sync():
+#define CROCKET_SYNC_OFF      0  //!< no synchronization
+#define CROCKET_SYNC_LEADER   1  //!< send time and play state to followers
+#define CROCKET_SYNC_FOLLOWER 2  //!< follow a leader's time and play state
+
+//! clock synchronization statistics
+typedef struct _sync_stats {
+    int role;                   //!< current role (CROCKET_SYNC_xxx)
+    unsigned int packets;       //!< number of packets sent or received
+    unsigned int seeks;         //!< number of hard seeks (jumps) signalled
+    float offset;               //!< follower: remaining offset to the leader's time, in seconds
+    float correction;           //!< follower: current correction added to the application time, in seconds
+    float drift;                //!< follower: estimated clock drift relative to the leader, in seconds per second
+    float age;                  //!< follower: time since the last packet from the leader, in seconds
+} crocket_sync_stats_t;
+
+//! get the current clock synchronization statistics
+extern void crocket_get_sync_stats(crocket_sync_stats_t* stats);
+
 //! switch between client and player mode at runtime
 //! \param mode  CROCKET_MODE_PLAYER to disconnect from the server and
 //!              continue running in player mode;
 //!              CROCKET_MODE_CLIENT to reconnect to the server
 extern void crocket_set_mode(int mode);
 
+//! prepare the track data for playback after editing
+//! \note This moves the keys of all tracks into a single block of memory,
+//!       without any unused capacity, and builds the baked tables of all
+//!       tracks if baking is enabled (see crocket_bake()). Apart from that,
+//!       sampling works exactly as before; no additional search structures
+//!       are built. It's called automatically when switching to player mode
+//!       with crocket_set_mode().
+extern void crocket_freeze(void);
+
+//! enable or disable lazy track loading in client mode
+//! \param enable  nonzero to request tracks from the server only when they
+//!                are first sampled, i.e. by crocket_update() (for enabled
+//!                groups only, see crocket_enable_group()) or
+//!                crocket_get_value(), or activated with crocket_activate();
+//!                zero to request all tracks (default)
+//! \note Call this before crocket_init() to make connecting to the server
+//!       fast even with huge numbers of tracks. Since all groups are enabled
+//!       initially, disable the groups that aren't needed yet before the
+//!       first crocket_update() call. Until its keys have arrived (which
+//!       happens asynchronously), a track has the value 0. Disabling lazy
+//!       mode activates all tracks.
+extern void crocket_set_lazy(int enable);
+
+//! enable or disable the hash sync protocol extension in client mode
+//! \param enable  nonzero to use the extension if the server advertises it
+//!                on connect, zero to use the plain protocol (default)
+//! \note If the server supports the extension, each track request carries a
+//!       content hash of the keys (see crocket_track_hash()), and only tracks
+//!       whose keys differ from the ones the client already has are
+//!       transferred, which makes reconnecting fast even with huge projects.
+//!       Nothing unusual is sent to servers without the extension.
+extern void crocket_set_hash_sync(int enable);
+
+//! activate all tracks whose names start with a specific prefix
+//! (e.g. "scene1:"), i.e. request them from the server in lazy mode
+//! \param prefix  track name prefix; "" or NULL to activate all tracks
+//! \returns the number of newly activated tracks
+//! \note Activation ends in crocket_done().
+extern unsigned int crocket_activate(const char* prefix);
+
+//! enable or disable lazy decoding of track data in player mode
+//! \param enable  nonzero to decode the keys of each track only when the
+//!                track is first sampled, returned by crocket_find_track()
+//!                or prefetched with crocket_prefetch(); zero to decode all
+//!                tracks in crocket_init() (default)
+//! \note Call this before crocket_init(). The loader then only scans the
+//!       track data to find the tracks' positions. Consequently, the
+//!       track_data buffer passed to crocket_init() must stay valid until
+//!       crocket_done(). Lazy decoding only works with plain CTF data;
+//!       compressed CTF data is always decoded completely.
+extern void crocket_set_lazy_decode(int enable);
+
+//! decode the keys of all tracks whose names start with a specific prefix
+//! (e.g. "scene1:") if that didn't happen yet (see crocket_set_lazy_decode())
+//! \param prefix  track name prefix; "" or NULL to decode all tracks
+//! \returns the number of newly decoded tracks
+extern unsigned int crocket_prefetch(const char* prefix);
+
+//! native socket handle type (SOCKET on Windows, file descriptor elsewhere)
+#ifdef _WIN32
+    #ifdef _WIN64
+    typedef unsigned long long crocket_socket_t;
+    #else
+    typedef unsigned int crocket_socket_t;
+    #endif
+#else
+    typedef int crocket_socket_t;
+#endif
+#define CROCKET_NO_SOCKET ((crocket_socket_t)(-1))
+
+//! get the socket of the current server connection, for integration into
+//! an application's own event loop (select, poll, epoll, etc.)
+//! \param p_events  receives the readiness events the application shall
+//!                  wait for (CROCKET_POLL_xxx bitmask)
+//! \returns the socket, or CROCKET_NO_SOCKET if not connected or if the
+//!          connection doesn't use a socket (shared memory transport)
+//! \note After the first call of this function (with a socket-based
+//!       transport), crocket_update() no longer
+//!       checks for incoming messages itself; instead, the application must
+//!       call crocket_on_readable() whenever the socket becomes readable.
+//!       The socket changes when the connection is re-established, so the
+//!       application should query it again after CROCKET_EVENT_CONNECT and
+//!       CROCKET_EVENT_DISCONNECT. To let crocket_update() poll the
+//!       connection again, call crocket_release_socket(); crocket_done()
+//!       does that as well.
+extern crocket_socket_t crocket_get_socket(int *p_events);
+// readiness events for crocket_get_socket():
+#define CROCKET_POLL_READ  (1 << 0)  //!< wait until the socket is readable
+#define CROCKET_POLL_WRITE (1 << 1)  //!< wait until the socket is writable
+
+//! process all data that is available on the server connection, without
+//! waiting for anything
+//! \returns nonzero if still connected
+//! \note Events resulting from the received messages are returned by the
+//!       next call to crocket_update().
+extern int crocket_on_readable(void);
+
+//! stop waiting for the server connection in the application's event loop
+//! \note Afterwards, crocket_update() checks for incoming messages itself
+//!       again, until crocket_get_socket() is called the next time.
+extern void crocket_release_socket(void);
+
 //! produce a CTF (Crocket Compact Track Format) dump of the track data
 //! \param p_size  pointer to a variable that shall receive the size,
 //!                in bytes, of the produced data
@@ -105,36 +288,305 @@ extern void crocket_set_mode(int mode);
 //! \note always returns NULL and zero size in CROCKET_PLAYER_ONLY mode
 extern void* crocket_get_track_data(int *p_size);
 
+//! select the CTF variant that crocket_get_track_data() produces
+//! \param format     CROCKET_CTF_PLAIN for the classic CTF format,
+//!                   CROCKET_CTF_COMPRESSED for the entropy-coded variant
+//! \param precision  quantization step for key values in compressed CTF;
+//!                   use 0 to store values losslessly
+//! \note The loader accepts both variants automatically, even in
+//!       CROCKET_PLAYER_ONLY mode. This function is a no-op in that mode.
+extern void crocket_set_ctf_format(int format, float precision);
+// possible formats for crocket_set_ctf_format():
+#define CROCKET_CTF_PLAIN      0  //!< plain CTF (default)
+#define CROCKET_CTF_COMPRESSED 1  //!< compressed CTF for size-limited productions
+
+//! remove redundant keys from all tracks and optionally quantize their values
+//! (see crocket_optimize_track() for details)
+//! \returns the total number of removed keys
+//! \note The result can be saved with crocket_get_track_data(). Since the
+//!       server is not informed about the changes, this should only be used
+//!       in player mode.
+//! \note always returns zero in CROCKET_PLAYER_ONLY mode
+extern unsigned int crocket_optimize(float tolerance, float precision);
+
 
 //////////////////////////////////////////////////////////////////////////////
 ///// LOW-LEVEL API (for direct track data access)                       /////
 //////////////////////////////////////////////////////////////////////////////
 
 //! data for a single keyframe
+//! \note The row and interpolation mode are packed into a single field to
+//!       make keys 8 bytes large; use the crocket_key_*() functions below
+//!       to access them.
 typedef struct _key {
-    unsigned int row;        //!< keyframe time (in rows, not seconds!)
+    unsigned int row_mode;   //!< keyframe time (in rows, not seconds!) in bits 0-29,
+                             //!< interpolation mode (0=none, 1=linear, 2=smoothstep, 3=quadratic) in bits 30-31
     float value;             //!< keyframe value
-    unsigned char interpol;  //!< interpolation mode (0=none, 1=linear, 2=smoothstep, 3=quadratic)
 } crocket_key_t;
 
+#define CROCKET_KEY_MAX_ROW 0x3FFFFFFFu  //!< highest row a key can be set on
+#define CROCKET_KEY_MODE_SHIFT 30        //!< bit position of the interpolation mode in crocket_key_t.row_mode
+
+//! get the row of a keyframe
+static inline unsigned int crocket_key_row(const crocket_key_t* k) {
+    return k->row_mode & CROCKET_KEY_MAX_ROW;
+}
+
+//! get the interpolation mode of a keyframe
+static inline unsigned int crocket_key_interpol(const crocket_key_t* k) {
+    return k->row_mode >> CROCKET_KEY_MODE_SHIFT;
+}
+
+//! set the row and interpolation mode of a keyframe
+//! \note Rows beyond CROCKET_KEY_MAX_ROW are clamped. Unknown interpolation
+//!       modes are stored as 0 (none), which is how they are sampled anyway.
+static inline void crocket_key_set_row(crocket_key_t* k, unsigned int row, unsigned int interpol) {
+    if (row > CROCKET_KEY_MAX_ROW) { row = CROCKET_KEY_MAX_ROW; }
+    if (interpol > 3) { interpol = 0; }
+    k->row_mode = row | (interpol << CROCKET_KEY_MODE_SHIFT);
+}
+
+#define CROCKET_INLINE_KEYS 2  //!< number of keys stored in the track record itself
+
 //! data for a whole track
 typedef struct _track {
     float *p_var;         //!< pointer to the associated variable
     const char* name;     //!< name of the track
     unsigned int nkeys;   //!< number of valid keyframes
     unsigned int alloc;   //!< current capacity of the 'keys' array
-    crocket_key_t* keys;  //!< keyframe data
+    crocket_key_t* keys;  //!< keyframe data (points to 'inline_keys' for
+                          //!< tracks with up to CROCKET_INLINE_KEYS keys)
+    crocket_key_t inline_keys[CROCKET_INLINE_KEYS];  //!< storage for small tracks
+    unsigned char kind;   //!< track class (CROCKET_TRACK_*), selects the sampler
+    unsigned char valid;  //!< nonzero if the variable of an empty or constant
+                          //!< track has already been written
+    unsigned char bake_pending;  //!< nonzero if the track still needs to be baked
+    unsigned char active;        //!< nonzero if the track is requested from the server
+    unsigned char vector;        //!< number of components if this is the first
+                                 //!< track of a vector variable (var3/var4), else 0
+    unsigned char component;     //!< index of the track in its vector variable
+    unsigned char shared_keys;   //!< (first track of a vector variable only)
+                                 //!< nonzero if all components have their keys
+                                 //!< at the same rows, with the same modes
+    float* table;              //!< baked lookup table (see crocket_bake()):
+                               //!< value at the start and value just before
+                               //!< the end of each cell, or NULL
+    unsigned int table_start;  //!< row of the first cell of the baked table
+    unsigned int table_size;   //!< number of cells in the baked table
+    const unsigned char* ctf_keys;  //!< position of the keys in the CTF data
+                                    //!< if not decoded yet, or NULL
+    unsigned int key_hash;        //!< content hash of the keys (see crocket_track_hash())
+    unsigned char hash_valid;     //!< nonzero if key_hash is up to date
 } crocket_track_t;
 
+// track classes, as determined by crocket_classify_track():
+#define CROCKET_TRACK_EMPTY    0  //!< no keys at all
+#define CROCKET_TRACK_CONSTANT 1  //!< all keys have the same value
+#define CROCKET_TRACK_STEP     2  //!< only uninterpolated segments
+#define CROCKET_TRACK_LINEAR   3  //!< only uninterpolated and linear segments
+#define CROCKET_TRACK_GENERAL  4  //!< anything else
+#define CROCKET_TRACK_BAKED    5  //!< sampled from a baked lookup table
+#define CROCKET_TRACK_UNDECODED 6 //!< keys not decoded yet (see crocket_set_lazy_decode())
+
+//! header of a value table from crocket_get_value_table()
+//! \note Value tables are meant to be written to disk and memory-mapped
+//!       as-is. All values are stored in native byte order. The header is
+//!       followed by the null-terminated names of all tracks, one after
+//!       another, at 'names_offset', and the values as 32-bit floats at
+//!       'data_offset' (aligned to 64 bytes).
+typedef struct _value_table {
+    char signature[8];          //!< CROCKET_VALUE_TABLE_SIGNATURE
+    unsigned int version;       //!< CROCKET_VALUE_TABLE_VERSION
+    unsigned int layout;        //!< CROCKET_TABLE_ROW_MAJOR or CROCKET_TABLE_COLUMN_MAJOR
+    unsigned int nframes;       //!< number of frames
+    unsigned int ntracks;       //!< number of tracks
+    float fps;                  //!< frame rate
+    float start;                //!< time of the first frame
+    unsigned int names_offset;  //!< offset of the track names, in bytes
+    unsigned int data_offset;   //!< offset of the value data, in bytes
+} crocket_value_table_t;
+#define CROCKET_VALUE_TABLE_SIGNATURE "crocktab"
+#define CROCKET_VALUE_TABLE_VERSION   1
+
+//! get a pointer to the value of a track in a specific frame of a value table
+#define CROCKET_VALUE_TABLE_ENTRY(tab, frame, track) \
+    ((const float*)((const char*)(tab) + (tab)->data_offset) \
+    + (((tab)->layout == CROCKET_TABLE_ROW_MAJOR) \
+        ? ((frame) * (tab)->ntracks + (track)) \
+        : ((track) * (tab)->nframes + (frame))))
+
+//! header of the shared memory segment created by crocket_publish()
+//! \note The header is followed by a directory of all tracks (an array of
+//!       crocket_shared_track_t) at 'directory_offset', and the values of all
+//!       tracks as 32-bit floats at 'values_offset'. Readers must only access
+//!       the segment if 'signature' is set, and use 'sequence' to get
+//!       consistent snapshots (seqlock protocol): read 'sequence', retry if
+//!       it is odd, copy the data, and retry if 'sequence' changed meanwhile
+//!       (with memory barriers before and after copying the data).
+typedef struct _shared_values {
+    char signature[8];              //!< CROCKET_SHARED_VALUES_SIGNATURE
+    unsigned int version;           //!< CROCKET_SHARED_VALUES_VERSION
+    volatile unsigned int sequence; //!< update counter, odd during updates
+    unsigned int ntracks;           //!< number of tracks
+    unsigned int directory_offset;  //!< offset of the track directory, in bytes
+    unsigned int values_offset;     //!< offset of the value array, in bytes
+    int state;                      //!< last return value of crocket_update()
+    float time;                     //!< last time passed to crocket_update()
+    float row;                      //!< current row
+} crocket_shared_values_t;
+#define CROCKET_SHARED_VALUES_SIGNATURE "crockshm"
+#define CROCKET_SHARED_VALUES_VERSION   1
+
+//! directory entry of a track in a crocket_publish() shared memory segment
+typedef struct _shared_track {
+    unsigned int name_offset;   //!< offset of the null-terminated track name, in bytes
+    unsigned int value_offset;  //!< offset of the track's value, in bytes
+} crocket_shared_track_t;
+
+//! size of each ring buffer of the shared memory transport, in bytes
+#define CROCKET_SHM_RING_SIZE 65536
+
+//! single-producer, single-consumer ring buffer in shared memory
+//! \note 'head' and 'tail' are free-running byte counters; only the producer
+//!       writes 'head', and only the consumer writes 'tail'.
+typedef struct _shm_ring {
+    volatile unsigned int head;     //!< total number of bytes written
+    volatile unsigned int tail;     //!< total number of bytes read
+    unsigned char data[CROCKET_SHM_RING_SIZE];  //!< ring buffer data
+} crocket_shm_ring_t;
+
+//! layout of the shared memory segment used by the "shm:" transport
+//! \note The segment is created by the server (editor or proxy). Its
+//!       'server_session' is nonzero while the server is accepting a client,
+//!       and changes whenever the server resets the connection; the client
+//!       treats any change as a disconnect. 'client_attached' is set by the
+//!       client while it is connected. The byte stream carried in both
+//!       directions is exactly the same as on a TCP connection.
+typedef struct _shm_transport {
+    char signature[8];                      //!< CROCKET_SHM_TRANSPORT_SIGNATURE
+    unsigned int version;                   //!< CROCKET_SHM_TRANSPORT_VERSION
+    volatile unsigned int server_session;   //!< current session ID (0 = not ready)
+    volatile unsigned int client_attached;  //!< nonzero if a client is connected
+    crocket_shm_ring_t to_server;           //!< data sent from client to server
+    crocket_shm_ring_t to_client;           //!< data sent from server to client
+} crocket_shm_transport_t;
+#define CROCKET_SHM_TRANSPORT_SIGNATURE "crockipc"
+#define CROCKET_SHM_TRANSPORT_VERSION   1
+
+//! write data into a shared memory ring buffer, without blocking
+//! \returns the number of bytes actually written (0 if the ring is full)
+extern int crocket_ring_write(crocket_shm_ring_t* ring, const void* data, int bytes);
+
+//! read data from a shared memory ring buffer, without blocking
+//! \returns the number of bytes actually read (0 if the ring is empty)
+extern int crocket_ring_read(crocket_shm_ring_t* ring, void* data, int bytes);
+
 //! conversion factor from seconds to rows, as set up in crocket_init()
 //! \note rows = seconds * crocket_timescale
 extern float crocket_timescale;
 
+//! add a track at runtime, in addition to the ones from crocket_vars.h
+//! \param name   name of the track (will be copied)
+//! \param p_var  variable that receives the track's value in crocket_update()
+//! \returns the index of the track, or -1 on error
+//! \note Tracks registered before crocket_init() receive their keys from
+//!       the track data loaded there; in client mode, tracks are requested
+//!       from the server immediately. Registering an existing name only
+//!       changes the track's variable. Registration is permanent, i.e. it's
+//!       not undone by crocket_done(). Pointers to tracks (as returned by
+//!       crocket_find_track()) become invalid when a new track is added.
+extern int crocket_register_track(const char* name, float* p_var);
+
+//! attach an additional track data source for a set of tracks
+//! \param prefix      name prefix of the tracks to load from the source
+//!                    (e.g. "scene1:"); "" or NULL for all tracks
+//! \param filename    name of a CTF file to load the data from
+//! \param track_data  CTF data in memory; if not NULL, filename is ignored
+//!                    and the data must stay valid until it has been
+//!                    applied (see crocket_attach_pending())
+//! \returns nonzero if the source is being loaded, zero on error or in
+//!          client mode (where all keys come from the server)
+//! \note Loading and decoding happens on a separate thread. The keys of the
+//!       affected tracks are replaced in the first crocket_update() call
+//!       after decoding has finished; until then, the tracks keep their old
+//!       keys. Tracks of the source that don't match the prefix are ignored.
+//!       Call this after crocket_init(). Switching to client mode with
+//!       crocket_set_mode() cancels all pending calls.
+extern int crocket_attach(const char* prefix, const char* filename, const void* track_data);
+
+//! remove the keys of all tracks whose names start with a specific prefix
+//! (e.g. when the scene they belong to is over)
+//! \param prefix  track name prefix; "" or NULL for all tracks
+//! \returns the number of tracks that lost their keys
+//! \note Pending crocket_attach() calls for the tracks are cancelled.
+//!       The affected variables are set to zero by the next crocket_update().
+extern unsigned int crocket_detach(const char* prefix);
+
+//! get the number of crocket_attach() calls whose data hasn't been applied
+//! to the tracks yet
+extern unsigned int crocket_attach_pending(void);
+
+//! memory allocation hooks for key data (see crocket_set_allocator())
+typedef struct _crocket_allocator {
+    void* (*alloc)(size_t size, void* user);           //!< allocate memory
+    void (*free)(void* ptr, size_t size, void* user);  //!< free memory (with the allocated size)
+    void* user;                                        //!< passed to the hooks
+} crocket_allocator_t;
+
+//! set the functions used to allocate and free key data
+//! \param allocator  the allocation hooks (the structure is copied);
+//!                   NULL to use malloc() and free() (default)
+//! \note Call this before crocket_init(), and don't change it while any
+//!       track data (including lists from crocket_load_tracks()) exists.
+//!       The hooks may be called from crocket_attach()'s worker threads.
+extern void crocket_set_allocator(const crocket_allocator_t* allocator);
+
+//! enable or disable arena mode for key data
+//! \param enable  nonzero to allocate the keys of all tracks loaded in
+//!                crocket_init() as a single block, and to keep the key
+//!                arrays of growing tracks in client mode in pools for
+//!                reuse; zero to allocate each key array separately (default)
+//! \note Call this before crocket_init(). Arena and pools are released in
+//!       crocket_done().
+extern void crocket_set_arena(int enable);
+
+//! find a track group by name
+//! \param name  name of the group, i.e. the part of the track names before
+//!              the first colon (e.g. "scene1" for "scene1:camera.x");
+//!              "" for the tracks without a colon
+//! \returns a handle for crocket_enable_group(), or -1 if not found
+//! \note Groups are computed in crocket_init() (and extended by
+//!       crocket_register_track()); all groups are enabled initially.
+extern int crocket_find_group(const char* name);
+
+//! enable or disable sampling of all tracks of a group in crocket_update()
+//! \param group   group handle from crocket_find_group()
+//! \param enable  zero to stop updating the group's variables (they keep
+//!                their last values), nonzero to update them again
+extern void crocket_enable_group(int group, int enable);
+
+//! enable or disable sampling of all groups whose names start with a prefix
+//! \param prefix  group name prefix; "" or NULL for all groups
+//! \returns the number of affected groups
+extern unsigned int crocket_enable_groups(const char* prefix, int enable);
+
 //! find a specific track by its variable
 //! \param p_var  pointer to the variable of the track to locate
 //! \returns the desired track, or NULL if not found
 extern const crocket_track_t* crocket_find_track(const float* p_var);
 
+//! get a track by its index
+//! \param index  track index; the tracks from crocket_vars.h have the indices
+//!               0 to N-1 in the order of that file, followed by the tracks
+//!               from crocket_register_track()
+//! \returns the desired track, or NULL if the index is out of range
+//! \note Unlike crocket_find_track(), this doesn't need to search.
+extern const crocket_track_t* crocket_get_track(unsigned int index);
+
+//! query a track's value at a specific time, like crocket_get_value(), but
+//! identify the track by its index instead of its variable
+extern float crocket_get_track_value(unsigned int index, float time);
+
 //! find the position of a specific keyframe segment in the keys of a track
 //! \param t    the track to query
 //! \param row  the row number to search
@@ -151,10 +603,136 @@ extern unsigned int crocket_find_key(const crocket_track_t* t, unsigned int row)
 //! \returns the requested value
 extern float crocket_sample(const crocket_track_t* t, float row);
 
+//! sample all components of a vector variable (var3/var4) at once
+//! \param t       the first track of the vector variable
+//! \param row     the time to query (in rows)
+//! \param values  receives the values of all components
+//! \returns the number of components (1 if t is not a vector variable)
+//! \note If all components have keys at the same rows, the key search and
+//!       the interpolation factor are shared by all components.
+extern unsigned int crocket_sample_vector(const crocket_track_t* t, float row, float* values);
+
+//! determine the class of a track (and thus the sampler to use for it)
+//! \note This must be called after modifying the keys of a track directly;
+//!       all functions of the library that modify tracks do so already.
+extern void crocket_classify_track(crocket_track_t* t);
+
+//! get the content hash of a track's keys
+//! \note The hash is the sum (modulo 2^32) of a hash of each key's row,
+//!       interpolation mode and value bits, so it can be updated
+//!       incrementally when single keys change. It's cached in the track
+//!       and invalidated by crocket_classify_track().
+extern unsigned int crocket_track_hash(crocket_track_t* t);
+
+//! remove redundant keys from a track and optionally quantize its values
+//! \param t          the track to optimize
+//! \param tolerance  maximum deviation of the optimized curve from the
+//!                   (quantized) original one; the curves are compared
+//!                   at every quarter row
+//! \param precision  quantization step for the key values;
+//!                   use 0 to keep the values as they are
+//! \returns the number of removed keys
+//! \note always returns zero in CROCKET_PLAYER_ONLY mode
+extern unsigned int crocket_optimize_track(crocket_track_t* t, float tolerance, float precision);
+
+//! load CTF data into a new list of tracks that is independent from the
+//! registered tracks and variables (e.g. for tools that process CTF files)
+//! \param track_data  CTF data (plain or compressed)
+//! \returns an array of tracks, terminated by a track with a NULL name,
+//!          with all 'p_var' pointers set to NULL;
+//!          NULL if the data is not in CTF format
+//! \note The array must be freed with crocket_free_tracks().
+extern crocket_track_t* crocket_load_tracks(const void* track_data);
+
+//! produce a CTF dump of a track list from crocket_load_tracks()
+//! (see crocket_get_track_data() for details)
+extern void* crocket_save_tracks(const crocket_track_t* tracks, int *p_size);
+
+//! free a track list from crocket_load_tracks()
+extern void crocket_free_tracks(crocket_track_t* tracks);
+
+//! sample a track list into a value table
+//! (see crocket_get_value_table() for details)
+//! \param tracks     the tracks to sample, terminated by a track with a NULL name
+//! \param timescale  conversion factor from table time to rows
+extern void* crocket_make_value_table(const crocket_track_t* tracks, float timescale, float fps, float start, float end, int layout, int threads, int *p_size);
+
+
+//////////////////////////////////////////////////////////////////////////////
+///// INLINE SAMPLING (for hot loops in application code)                /////
+//////////////////////////////////////////////////////////////////////////////
+
+//! compute the interpolation factor between two adjacent keys k[0] and k[1]
+static inline float crocket_interpolation_factor(const crocket_key_t* k, float row) {
+    float x = (row - (float)crocket_key_row(&k[0])) / (float)(crocket_key_row(&k[1]) - crocket_key_row(&k[0]));
+    switch (crocket_key_interpol(&k[0])) {
+        case 1:  /* linear */     break;
+        case 2:  /* smoothstep */ x *= x * (3.0f - 2.0f * x);  break;
+        case 3:  /* ramp-up */    x *= x; break;
+        default: /* unknown */    x = 0.0f; break;
+    }
+    return x;
+}
+
+//! interpolate between two adjacent keys k[0] and k[1]
+static inline float crocket_interpolate(const crocket_key_t* k, float row) {
+    return k[0].value + crocket_interpolation_factor(k, row) * (k[1].value - k[0].value);
+}
+
+//! inline version of crocket_find_key()
+static inline unsigned int crocket_find_key_inline(const crocket_track_t* t, unsigned int row) {
+    unsigned int a, b, c, pivot;
+    if (!t || !t->nkeys || (row < crocket_key_row(&t->keys[0]))) {
+        return 0;  // before first key
+    }
+    a = 0;
+    b = t->nkeys;
+    while ((a + 1) < b) {
+        c = (a + b) >> 1;
+        pivot = crocket_key_row(&t->keys[c]);
+        if (row == pivot) {
+            return c + 1;  // shortcut for exact hit
+        }
+        if (row > pivot) { a = c; }
+                    else { b = c; }
+    }
+    return a + 1;
+}
+
+//! inline version of crocket_sample(), so that the compiler can optimize
+//! sampling together with the surrounding code
+//! \note Tracks with baked tables (or keys that haven't been decoded yet)
+//!       are still sampled by calling crocket_sample().
+static inline float crocket_sample_inline(const crocket_track_t* t, float row) {
+    const crocket_key_t* k;
+    unsigned int pos;
+    if (!t || (t->kind > CROCKET_TRACK_GENERAL)) { return crocket_sample(t, row); }
+    if (t->kind == CROCKET_TRACK_EMPTY)    { return 0.0f; }
+    if (t->kind == CROCKET_TRACK_CONSTANT) { return t->keys[0].value; }
+    pos = crocket_find_key_inline(t, (row <= 0.0f) ? 0 : (unsigned int)row);
+    if (!pos) { return t->keys[0].value; }  // before first key
+    k = &t->keys[pos-1];
+    if ((pos >= t->nkeys) || !crocket_key_interpol(&k[0]) || (t->kind == CROCKET_TRACK_STEP)) {
+        return k[0].value;  // after last key, or uninterpolated
+    }
+    if (t->kind == CROCKET_TRACK_LINEAR) {
+        return (crocket_key_interpol(&k[0]) != 1) ? k[0].value
+             : (k[0].value + (row - (float)crocket_key_row(&k[0])) / (float)(crocket_key_row(&k[1]) - crocket_key_row(&k[0])) * (k[1].value - k[0].value));
+    }
+    return crocket_interpolate(k, row);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
 #ifdef __cplusplus
 }
 #endif
 
+// single-header mode: define CROCKET_IMPLEMENTATION in exactly one C file
+// before including this header to compile the library into that file
+#if defined(CROCKET_IMPLEMENTATION) && !defined(_CROCKET_IMPLEMENTATION_INCLUDED)
+#define _CROCKET_IMPLEMENTATION_INCLUDED
+#include "crocket.c"
+#endif
+
 #endif // _CROCKET_H_
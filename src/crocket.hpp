@@ -0,0 +1,140 @@
+//! \file crocket.hpp
+//! \brief optional C++17 interface with compile-time track handles
+//! \note This header only adds inline wrappers around the C API from
+//!       crocket.h; crocket.c still needs to be compiled as C.
+
+// Copyright (C) 2018 Martin J. Fiedler (KeyJ^TRBL)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef _CROCKET_HPP_
+#define _CROCKET_HPP_
+
+#include <array>
+#include <cstddef>
+
+#include "crocket.h"
+
+namespace crocket {
+
+namespace detail {
+    //! track indices, in the order of crocket_vars.h
+    enum track_index : unsigned int {
+        #define var(s,n) index_##s,
+        #define var3(s,n) index_##s, index_##s##_1, index_##s##_2,
+        #define var4(s,n) index_##s, index_##s##_1, index_##s##_2, index_##s##_3,
+        #include "crocket_vars.h"
+        #undef var
+        #undef var3
+        #undef var4
+        track_count
+    };
+
+    //! track names, in the order of crocket_vars.h
+    inline constexpr const char* track_names[] = {
+        #define var(s,n) n,
+        #define var3(s,n) n ".x", n ".y", n ".z",
+        #define var4(s,n) n ".x", n ".y", n ".z", n ".w",
+        #include "crocket_vars.h"
+        #undef var
+        #undef var3
+        #undef var4
+        nullptr
+    };
+}
+
+//! number of tracks defined in crocket_vars.h
+inline constexpr unsigned int track_count = detail::track_count;
+
+//! compile-time handle for a track from crocket_vars.h
+template <unsigned int Index>
+struct track_handle {
+    static_assert(Index < track_count, "invalid track index");
+    static constexpr unsigned int index = Index;  //!< index of the track
+    static constexpr const char* name() { return detail::track_names[Index]; }
+};
+
+//! compile-time handle for a vector variable (var3/var4) from crocket_vars.h
+//! \note The handle refers to the first component; name() includes the ".x".
+template <unsigned int Index, unsigned int Components>
+struct vector_handle : track_handle<Index> {
+    static constexpr unsigned int components = Components;  //!< number of components
+};
+
+//! handles for all tracks from crocket_vars.h, named like their variables
+//! (e.g. crocket::tracks::camera_x for var(camera_x, "camera.x"))
+namespace tracks {
+    #define var(s,n) inline constexpr track_handle<detail::index_##s> s{};
+    #define var3(s,n) inline constexpr vector_handle<detail::index_##s, 3> s{};
+    #define var4(s,n) inline constexpr vector_handle<detail::index_##s, 4> s{};
+    #include "crocket_vars.h"
+    #undef var
+    #undef var3
+    #undef var4
+}
+
+//! get the underlying track of a handle
+//! \note The pointer becomes invalid when crocket_register_track() is called.
+template <typename Track>
+inline const crocket_track_t* get(Track = {}) {
+    return crocket_get_track(Track::index);
+}
+
+//! sample a track at a specific row (see crocket_sample())
+template <typename Track>
+inline float sample(float row, Track = {}) {
+    return crocket_sample_inline(crocket_get_track(Track::index), row);
+}
+
+//! query a track's value at a specific time (see crocket_get_value())
+template <typename Track>
+inline float value(float time, Track = {}) {
+    return crocket_get_track_value(Track::index, time);
+}
+
+//! sample multiple tracks at the same row
+//! \returns the values, in the order of the handles
+template <typename... Tracks>
+inline std::array<float, sizeof...(Tracks)> sample_all(float row, Tracks...) {
+    return {{ crocket_sample_inline(crocket_get_track(Tracks::index), row)... }};
+}
+
+//! sample all components of a vector variable (see crocket_sample_vector())
+template <typename Vector>
+inline std::array<float, Vector::components> sample_vector(float row, Vector = {}) {
+    std::array<float, Vector::components> values;
+    crocket_sample_vector(crocket_get_track(Vector::index), row, values.data());
+    return values;
+}
+
+//! sample a single track at many rows
+//! \param rows    the rows to sample
+//! \param values  destination for the results (one value per row)
+//! \param count   number of rows
+template <typename Track>
+inline void sample_rows(const float* rows, float* values, std::size_t count, Track = {}) {
+    const crocket_track_t* t = crocket_get_track(Track::index);
+    for (std::size_t i = 0;  i < count;  ++i) {
+        values[i] = crocket_sample_inline(t, rows[i]);
+    }
+}
+
+}  // namespace crocket
+
+#endif // _CROCKET_HPP_
@@ -0,0 +1,555 @@
+//! \file crocket_relay.c
+//! \brief fan-out relay: lets one Rocket editor drive many demo instances
+//! \note This tool is POSIX-only. It connects to the editor as a single
+//!       client and accepts any number of downstream clients. The editor
+//!       sees the union of all tracks requested by the clients; key edits
+//!       and seeks are broadcast to all clients, while the playback position
+//!       is only reported back to the editor by the leader (the client that
+//!       has been connected the longest).
+
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <errno.h>
+#include <time.h>
+
+#include "crocket.h"
+#include "net_util.h"
+
+#define MAX_CLIENTS 64                      //!< maximum number of downstream clients
+#define MAX_PENDING_OUTPUT (16 << 20)       //!< drop clients that fall behind further than this
+#define EDITOR_RETRY_INTERVAL 1             //!< seconds between editor connection attempts
+
+//! growable byte buffer for incoming and outgoing data
+typedef struct _buffer {
+    unsigned char* data;
+    size_t size;
+    size_t alloc;
+} buffer_t;
+
+//! a track, as known to the editor
+typedef struct _relay_track {
+    char* name;
+    crocket_key_t* keys;    //!< current keys, sorted by row
+    unsigned int nkeys;
+    unsigned int alloc;
+} relay_track_t;
+
+//! a downstream client
+typedef struct _client {
+    int fd;                 //!< socket, or -1 if the slot is free
+    int greeted;            //!< nonzero after CLIENT_GREET has been received
+    unsigned long serial;   //!< connection order (lowest = leader)
+    unsigned int* local_index;  //!< client-side index of each editor track (or ~0)
+    unsigned int nmap;          //!< number of entries in local_index
+    unsigned int map_alloc;     //!< capacity of local_index
+    unsigned int nlocal;        //!< number of tracks requested by the client
+    buffer_t in;
+    buffer_t out;
+} client_t;
+
+static int editor_fd = -1;
+static buffer_t editor_in, editor_out;
+static relay_track_t* tracks = NULL;
+static unsigned int ntracks = 0;
+static unsigned int tracks_alloc = 0;
+static unsigned int* track_index = NULL;     //!< hash table of track names (track index + 1, 0 = empty slot)
+static unsigned int track_index_size = 0;    //!< number of slots in track_index (power of two)
+static client_t clients[MAX_CLIENTS];
+static unsigned long next_serial = 0;
+static int verbose = 0;
+static char unix_path[256] = "";
+
+static void usage(void) {
+    printf("Usage: crocket_relay [-l LISTEN] [-v] [EDITOR_HOST[:PORT]]\n"
+           "Options:\n"
+           "  -l LISTEN  where to accept demo connections: tcp:PORT or unix:PATH\n"
+           "             (default: tcp:1339)\n"
+           "  -v         report client connections and track registrations\n"
+           "The editor defaults to localhost:1338.\n");
+}
+
+static void cleanup(void) {
+    if (unix_path[0]) { unlink(unix_path); }
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    exit(0);  // runs cleanup()
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// BUFFER AND TRACK MANAGEMENT                                         /////
+///////////////////////////////////////////////////////////////////////////////
+
+static void buf_append(buffer_t* b, const void* data, size_t size) {
+    if ((b->size + size) > b->alloc) {
+        size_t new_alloc = b->alloc ? b->alloc : 4096;
+        while (new_alloc < (b->size + size)) { new_alloc <<= 1; }
+        b->data = realloc(b->data, new_alloc);
+        if (!b->data) { fprintf(stderr, "out of memory\n"); exit(1); }
+        b->alloc = new_alloc;
+    }
+    memcpy(&b->data[b->size], data, size);
+    b->size += size;
+}
+
+static void buf_consume(buffer_t* b, size_t size) {
+    memmove(b->data, &b->data[size], b->size - size);
+    b->size -= size;
+}
+
+static void buf_free(buffer_t* b) {
+    free(b->data);
+    memset(b, 0, sizeof(buffer_t));
+}
+
+//! read everything that's available from a non-blocking socket
+//! \returns zero if the connection has been closed
+static int buf_fill(buffer_t* b, int fd) {
+    unsigned char tmp[4096];
+    for (;;) {
+        ssize_t res = recv(fd, tmp, sizeof(tmp), MSG_DONTWAIT);
+        if (res > 0) { buf_append(b, tmp, res); continue; }
+        if (res == 0) { return 0; }
+        return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+    }
+}
+
+//! write as much pending data as possible into a non-blocking socket
+//! \returns zero if the connection is broken
+static int buf_flush(buffer_t* b, int fd) {
+    size_t pos = 0;
+    while (pos < b->size) {
+        ssize_t res = send(fd, &b->data[pos], b->size - pos, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (res > 0) { pos += res; continue; }
+        if ((res < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))) { break; }
+        return 0;
+    }
+    buf_consume(b, pos);
+    return 1;
+}
+
+static unsigned int get_u32(const unsigned char* p) {
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+static void put_u32(unsigned char* p, unsigned int x) {
+    p[0] = (unsigned char)(x >> 24);
+    p[1] = (unsigned char)(x >> 16);
+    p[2] = (unsigned char)(x >>  8);
+    p[3] = (unsigned char) x;
+}
+
+static void track_set_key(relay_track_t* t, const crocket_key_t* key) {
+    unsigned int i;
+    for (i = 0;  (i < t->nkeys) && (crocket_key_row(&t->keys[i]) < crocket_key_row(key));  ++i);
+    if ((i < t->nkeys) && (crocket_key_row(&t->keys[i]) == crocket_key_row(key))) {
+        t->keys[i] = *key;
+        return;
+    }
+    if (t->nkeys >= t->alloc) {
+        t->alloc = t->alloc ? (t->alloc << 1) : 16;
+        t->keys = realloc(t->keys, t->alloc * sizeof(crocket_key_t));
+        if (!t->keys) { fprintf(stderr, "out of memory\n"); exit(1); }
+    }
+    memmove(&t->keys[i + 1], &t->keys[i], (t->nkeys - i) * sizeof(crocket_key_t));
+    t->keys[i] = *key;
+    ++t->nkeys;
+}
+
+static void track_delete_key(relay_track_t* t, unsigned int row) {
+    unsigned int i;
+    for (i = 0;  (i < t->nkeys) && (crocket_key_row(&t->keys[i]) != row);  ++i);
+    if (i >= t->nkeys) { return; }
+    --t->nkeys;
+    memmove(&t->keys[i], &t->keys[i + 1], (t->nkeys - i) * sizeof(crocket_key_t));
+}
+
+//! hash function for track names (FNV-1a)
+static unsigned int hash_name(const char* name) {
+    unsigned int h = 2166136261u;
+    while (*name) {
+        h = (h ^ (unsigned char)(*name++)) * 16777619u;
+    }
+    return h;
+}
+
+//! find a track by its name
+//! \returns the track index, or ntracks if not found
+static unsigned int find_track(const char* name) {
+    unsigned int slot;
+    if (!track_index) { return ntracks; }
+    for (slot = hash_name(name);  track_index[slot & (track_index_size - 1)];  ++slot) {
+        unsigned int index = track_index[slot & (track_index_size - 1)] - 1;
+        if (!strcmp(tracks[index].name, name)) { return index; }
+    }
+    return ntracks;
+}
+
+//! add the last track to the name index, growing the index if it gets too full
+static void index_new_track(void) {
+    unsigned int slot, i = ntracks - 1;
+    if ((ntracks * 2) > track_index_size) {
+        track_index_size = track_index_size ? (track_index_size * 2) : 1024;
+        free(track_index);
+        track_index = calloc(track_index_size, sizeof(unsigned int));
+        if (!track_index) { fprintf(stderr, "out of memory\n"); exit(1); }
+        i = 0;  // re-add all tracks
+    }
+    for (;  i < ntracks;  ++i) {
+        for (slot = hash_name(tracks[i].name);  track_index[slot & (track_index_size - 1)];  ++slot);
+        track_index[slot & (track_index_size - 1)] = i + 1;
+    }
+}
+
+//! queue a SET_KEY message for a client
+static void send_key(client_t* c, unsigned int local_index, const crocket_key_t* key) {
+    unsigned char msg[14];
+    union _val { unsigned int i; float f; } value;
+    value.f = key->value;
+    msg[0] = 0;  // SET_KEY
+    put_u32(&msg[1], local_index);
+    put_u32(&msg[5], crocket_key_row(key));
+    put_u32(&msg[9], value.i);
+    msg[13] = (unsigned char)crocket_key_interpol(key);
+    buf_append(&c->out, msg, 14);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// CONNECTION HANDLING                                                 /////
+///////////////////////////////////////////////////////////////////////////////
+
+static void drop_client(client_t* c) {
+    if (c->fd < 0) { return; }
+    close(c->fd);
+    if (verbose) { printf("client #%lu disconnected\n", c->serial); }
+    free(c->local_index);
+    buf_free(&c->in);
+    buf_free(&c->out);
+    memset(c, 0, sizeof(client_t));
+    c->fd = -1;
+}
+
+//! the leader is the client that has been connected the longest
+static client_t* get_leader(void) {
+    client_t* leader = NULL;
+    int i;
+    for (i = 0;  i < MAX_CLIENTS;  ++i) {
+        if ((clients[i].fd >= 0) && clients[i].greeted
+        &&  (!leader || (clients[i].serial < leader->serial))) {
+            leader = &clients[i];
+        }
+    }
+    return leader;
+}
+
+static void disconnect_editor(void) {
+    unsigned int i;
+    if (editor_fd < 0) { return; }
+    close(editor_fd);
+    editor_fd = -1;
+    buf_free(&editor_in);
+    buf_free(&editor_out);
+    printf("editor disconnected\n");
+
+    // the clients need to re-register their tracks with the next editor,
+    // so disconnect them too
+    for (i = 0;  i < MAX_CLIENTS;  ++i) {
+        drop_client(&clients[i]);
+    }
+    for (i = 0;  i < ntracks;  ++i) {
+        free(tracks[i].name);
+        free(tracks[i].keys);
+    }
+    free(tracks);
+    free(track_index);
+    tracks = NULL;
+    track_index = NULL;
+    ntracks = tracks_alloc = track_index_size = 0;
+}
+
+static int connect_editor(const char* spec) {
+    char greet[12];
+    int fd = net_connect(spec);
+    if (fd < 0) { return 0; }
+    if ((send(fd, "hello, synctracker!", 19, MSG_NOSIGNAL) != 19)
+    ||  (recv(fd, greet, 12, MSG_WAITALL) != 12)
+    ||  memcmp(greet, "hello, demo!", 12)) {
+        close(fd);
+        return 0;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    editor_fd = fd;
+    printf("connected to editor at %s\n", spec);
+    return 1;
+}
+
+static void accept_client(int listener) {
+    int fd = accept(listener, NULL, NULL), i;
+    if (fd < 0) { return; }
+    for (i = 0;  (i < MAX_CLIENTS) && (clients[i].fd >= 0);  ++i);
+    if ((i >= MAX_CLIENTS) || (editor_fd < 0)) {
+        close(fd);  // no free slot, or no editor to talk to
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    memset(&clients[i], 0, sizeof(client_t));
+    clients[i].fd = fd;
+    clients[i].serial = ++next_serial;
+    if (verbose) { printf("client #%lu connected\n", clients[i].serial); }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// MESSAGE HANDLING                                                    /////
+///////////////////////////////////////////////////////////////////////////////
+
+//! register a track for a client, adding it to the editor if necessary
+static void get_track(client_t* c, const char* name) {
+    unsigned int index, i;
+    index = find_track(name);
+    if (index >= ntracks) {
+        // new track: register with the editor
+        unsigned char msg[5];
+        unsigned int len = (unsigned int)strlen(name);
+        if (ntracks >= tracks_alloc) {
+            tracks_alloc = tracks_alloc ? (tracks_alloc << 1) : 256;
+            tracks = realloc(tracks, tracks_alloc * sizeof(relay_track_t));
+            if (!tracks) { fprintf(stderr, "out of memory\n"); exit(1); }
+        }
+        memset(&tracks[ntracks], 0, sizeof(relay_track_t));
+        tracks[ntracks].name = strdup(name);
+        if (!tracks[ntracks].name) { fprintf(stderr, "out of memory\n"); exit(1); }
+        ++ntracks;
+        index_new_track();
+        msg[0] = 2;  // GET_TRACK
+        put_u32(&msg[1], len);
+        buf_append(&editor_out, msg, 5);
+        buf_append(&editor_out, name, len);
+        if (verbose) { printf("track %u: %s\n", index, name); }
+    }
+
+    // map the editor's track index to the client's
+    // (indices of tracks the client doesn't use are ~0)
+    if (c->nmap < ntracks) {
+        if (c->map_alloc < ntracks) {
+            while (c->map_alloc < ntracks) { c->map_alloc = c->map_alloc ? (c->map_alloc << 1) : 256; }
+            c->local_index = realloc(c->local_index, c->map_alloc * sizeof(unsigned int));
+            if (!c->local_index) { fprintf(stderr, "out of memory\n"); exit(1); }
+        }
+        while (c->nmap < ntracks) { c->local_index[c->nmap++] = ~0u; }
+    }
+    if (c->local_index[index] == ~0u) {
+        c->local_index[index] = c->nlocal++;
+    }
+
+    // send the keys we already know about
+    for (i = 0;  i < tracks[index].nkeys;  ++i) {
+        send_key(c, c->local_index[index], &tracks[index].keys[i]);
+    }
+}
+
+//! parse complete messages from a client
+//! \returns zero if the client sent garbage
+static int handle_client_messages(client_t* c) {
+    size_t pos = 0;
+    int ok = 1;
+    if (!c->greeted) {
+        if (c->in.size < 19) { return 1; }
+        if (memcmp(c->in.data, "hello, synctracker!", 19)) { return 0; }
+        buf_append(&c->out, "hello, demo!", 12);
+        c->greeted = 1;
+        pos = 19;
+    }
+    while (ok && (pos < c->in.size)) {
+        size_t avail = c->in.size - pos;
+        const unsigned char* msg = &c->in.data[pos];
+        if (msg[0] == 2) {  // GET_TRACK
+            unsigned int len;
+            char* name;
+            if (avail < 5) { break; }
+            len = get_u32(&msg[1]);
+            if (len > 65536) { ok = 0; break; }
+            if (avail < (5 + (size_t)len)) { break; }
+            name = malloc(len + 1);
+            if (!name) { ok = 0; break; }
+            memcpy(name, &msg[5], len);
+            name[len] = '\0';
+            get_track(c, name);
+            free(name);
+            pos += 5 + len;
+        }
+        else if (msg[0] == 3) {  // SET_ROW
+            if (avail < 5) { break; }
+            if (c == get_leader()) { buf_append(&editor_out, msg, 5); }
+            pos += 5;
+        }
+        else { ok = 0; }  // unknown command, we can't continue parsing
+    }
+    buf_consume(&c->in, pos);
+    return ok;
+}
+
+//! broadcast a message from the editor to all clients
+static void broadcast(const unsigned char* msg, size_t size) {
+    int i;
+    for (i = 0;  i < MAX_CLIENTS;  ++i) {
+        if ((clients[i].fd >= 0) && clients[i].greeted) {
+            buf_append(&clients[i].out, msg, size);
+        }
+    }
+}
+
+//! forward a key change to all clients that use the track
+static void broadcast_track(unsigned int index, const unsigned char* msg, size_t size) {
+    int i;
+    for (i = 0;  i < MAX_CLIENTS;  ++i) {
+        client_t* c = &clients[i];
+        unsigned char local_msg[14];
+        if ((c->fd < 0) || (index >= c->nmap) || (c->local_index[index] == ~0u)) { continue; }
+        memcpy(local_msg, msg, size);
+        put_u32(&local_msg[1], c->local_index[index]);
+        buf_append(&c->out, local_msg, size);
+    }
+}
+
+//! parse complete messages from the editor
+//! \returns zero if the editor sent garbage
+static int handle_editor_messages(void) {
+    size_t pos = 0;
+    for (;;) {
+        size_t avail = editor_in.size - pos, size;
+        const unsigned char* msg = &editor_in.data[pos];
+        unsigned int index;
+        if (!avail) { break; }
+        switch (msg[0]) {
+            case 0:  size = 14; break;  // SET_KEY
+            case 1:  size =  9; break;  // DELETE_KEY
+            case 3:  size =  5; break;  // SET_ROW
+            case 4:  size =  2; break;  // PAUSE
+            case 5:  size =  1; break;  // SAVE_TRACKS
+            case 6:  size =  5; break;  // ACTION
+            case 7:  size =  1; break;  // HASH_SYNC (extension announcement)
+            default: return 0;  // unknown command, we can't continue parsing
+        }
+        if (avail < size) { break; }  // incomplete message
+        pos += size;
+        if (msg[0] == 7) {
+            continue;  // the relay doesn't support the hash sync extension
+        }
+        if (msg[0] > 1) {
+            broadcast(msg, size);
+            continue;
+        }
+
+        // SET_KEY or DELETE_KEY: update our copy of the track and forward it
+        index = get_u32(&msg[1]);
+        if (index >= ntracks) { return 0; }
+        if (msg[0] == 0) {
+            crocket_key_t key;
+            union _val { unsigned int i; float f; } value;
+            crocket_key_set_row(&key, get_u32(&msg[5]), msg[13]);
+            value.i = get_u32(&msg[9]);
+            key.value = value.f;
+            track_set_key(&tracks[index], &key);
+        }
+        else {
+            track_delete_key(&tracks[index], get_u32(&msg[5]));
+        }
+        broadcast_track(index, msg, size);
+    }
+    buf_consume(&editor_in, pos);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    const char *listen_spec = "tcp:1339", *editor_spec = "localhost:1338";
+    time_t last_attempt = 0;
+    int listener, i;
+
+    // parse command line
+    for (i = 1;  i < argc;  ++i) {
+        const char* arg = argv[i];
+        if (!strcmp(arg, "-l") && ((i + 1) < argc)) { listen_spec = argv[++i]; }
+        else if (!strcmp(arg, "-v")) { verbose = 1; }
+        else if (arg[0] != '-') { editor_spec = arg; }
+        else { usage(); return 2; }
+    }
+
+    // set up listener
+    atexit(cleanup);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IONBF, 0);
+    if (!strncmp(listen_spec, "unix:", 5)) {
+        strncpy(unix_path, &listen_spec[5], sizeof(unix_path) - 1);
+    }
+    listener = net_listen(listen_spec);
+    if (listener < 0) { perror("listen"); return 1; }
+    for (i = 0;  i < MAX_CLIENTS;  ++i) { clients[i].fd = -1; }
+    printf("listening on %s\n", listen_spec);
+
+    for (;;) {
+        fd_set rfds, wfds;
+        struct timeval tv;
+        int maxfd = listener;
+
+        // (re)connect to the editor; clients are only accepted while it's there
+        if ((editor_fd < 0) && (time(NULL) - last_attempt >= EDITOR_RETRY_INTERVAL)) {
+            last_attempt = time(NULL);
+            connect_editor(editor_spec);
+        }
+
+        // wait for something to happen
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        FD_SET(listener, &rfds);
+        if (editor_fd >= 0) {
+            FD_SET(editor_fd, &rfds);
+            if (editor_out.size) { FD_SET(editor_fd, &wfds); }
+            if (editor_fd > maxfd) { maxfd = editor_fd; }
+        }
+        for (i = 0;  i < MAX_CLIENTS;  ++i) {
+            if (clients[i].fd < 0) { continue; }
+            FD_SET(clients[i].fd, &rfds);
+            if (clients[i].out.size) { FD_SET(clients[i].fd, &wfds); }
+            if (clients[i].fd > maxfd) { maxfd = clients[i].fd; }
+        }
+        tv.tv_sec = EDITOR_RETRY_INTERVAL;
+        tv.tv_usec = 0;
+        if (select(maxfd + 1, &rfds, &wfds, NULL, &tv) < 0) {
+            if (errno == EINTR) { continue; }
+            perror("select");
+            return 1;
+        }
+
+        // collect all incoming data first ...
+        if (FD_ISSET(listener, &rfds)) {
+            accept_client(listener);
+        }
+        for (i = 0;  i < MAX_CLIENTS;  ++i) {
+            client_t* c = &clients[i];
+            if ((c->fd >= 0) && FD_ISSET(c->fd, &rfds)
+            && (!buf_fill(&c->in, c->fd) || !handle_client_messages(c))) {
+                drop_client(c);
+            }
+        }
+        if ((editor_fd >= 0) && FD_ISSET(editor_fd, &rfds)
+        && (!buf_fill(&editor_in, editor_fd) || !handle_editor_messages())) {
+            disconnect_editor();
+        }
+
+        // ... then send everything that has been queued, in as few writes as possible
+        if ((editor_fd >= 0) && !buf_flush(&editor_out, editor_fd)) {
+            disconnect_editor();
+        }
+        for (i = 0;  i < MAX_CLIENTS;  ++i) {
+            client_t* c = &clients[i];
+            if ((c->fd >= 0) && (!buf_flush(&c->out, c->fd) || (c->out.size > MAX_PENDING_OUTPUT))) {
+                drop_client(c);
+            }
+        }
+    }
+}
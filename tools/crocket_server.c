@@ -0,0 +1,364 @@
+//! \file crocket_server.c
+//! \brief stand-in Rocket server for testing the client transports
+//! \note This tool is POSIX-only. It can either act as a minimal editor that
+//!       serves the keys of a CTF file, or as a proxy that forwards a demo's
+//!       connection to a real editor. In both cases, the demo may connect
+//!       via TCP, a Unix domain socket or shared memory. As an editor, it
+//!       also supports the hash sync extension (see crocket_set_hash_sync()).
+
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "crocket.h"
+#include "tool_util.h"
+#include "net_util.h"
+
+#define MEMORY_BARRIER() __sync_synchronize()
+
+//! connection to the demo (or to the upstream editor)
+typedef struct _conn {
+    int fd;                         //!< socket, or -1 for shared memory
+    crocket_shm_transport_t* shm;   //!< shared memory segment, if fd < 0
+} conn_t;
+
+static int verbose = 0;
+static char shm_name[256] = "";        //!< name of the shared memory segment (for cleanup)
+static char unix_path[256] = "";       //!< path of the Unix domain socket (for cleanup)
+
+static void usage(void) {
+    printf("Usage: crocket_server [-l LISTEN] [-v] (-f FILE.ctf | -p HOST[:PORT])\n"
+           "Options:\n"
+           "  -l LISTEN     where to accept the demo's connection:\n"
+           "                tcp:PORT, unix:PATH or shm:NAME (default: tcp:1338)\n"
+           "  -f FILE.ctf   act as an editor that serves the keys from FILE.ctf\n"
+           "  -p HOST:PORT  forward the connection to a real editor\n"
+           "  -v            print all rows the demo seeks to\n"
+           "The demo selects the matching transport with the CROCKET_SERVER\n"
+           "environment variable, e.g. CROCKET_SERVER=unix:/tmp/rocket.sock\n");
+}
+
+static void cleanup(void) {
+    if (shm_name[0])  { shm_unlink(shm_name); }
+    if (unix_path[0]) { unlink(unix_path); }
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    exit(0);  // runs cleanup()
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// CONNECTION HANDLING                                                 /////
+///////////////////////////////////////////////////////////////////////////////
+
+//! start accepting a new client on a shared memory segment
+static void shm_new_session(crocket_shm_transport_t* shm) {
+    static unsigned int session = 0;
+    shm->server_session = 0;  // stop the old client, if any
+    MEMORY_BARRIER();
+    shm->to_server.head = shm->to_server.tail = 0;
+    shm->to_client.head = shm->to_client.tail = 0;
+    shm->client_attached = 0;
+    MEMORY_BARRIER();
+    if (!++session) { ++session; }
+    shm->server_session = session;
+}
+
+//! create a listening socket or shared memory segment
+//! \returns the listening socket, or -1 for shared memory (in which case
+//!          '*p_shm' is set)
+static int create_listener(const char* spec, crocket_shm_transport_t** p_shm) {
+    int fd;
+    *p_shm = NULL;
+    if (!strncmp(spec, "shm:", 4)) {
+        void* mem;
+        snprintf(shm_name, sizeof(shm_name), "%s%s", (spec[4] == '/') ? "" : "/", &spec[4]);
+        shm_unlink(shm_name);  // remove stale segments
+        fd = shm_open(shm_name, O_CREAT | O_RDWR, 0600);
+        if ((fd < 0) || ftruncate(fd, sizeof(crocket_shm_transport_t))) {
+            perror("shm_open");
+            exit(1);
+        }
+        mem = mmap(NULL, sizeof(crocket_shm_transport_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mem == MAP_FAILED) { perror("mmap"); exit(1); }
+        *p_shm = mem;
+        memset(mem, 0, sizeof(crocket_shm_transport_t));
+        (*p_shm)->version = CROCKET_SHM_TRANSPORT_VERSION;
+        MEMORY_BARRIER();
+        memcpy((*p_shm)->signature, CROCKET_SHM_TRANSPORT_SIGNATURE, 8);
+        return -1;
+    }
+    if (!strncmp(spec, "unix:", 5)) {
+        strncpy(unix_path, &spec[5], sizeof(unix_path) - 1);
+    }
+    fd = net_listen(spec);
+    if (fd < 0) { perror("listen"); exit(1); }
+    return fd;
+}
+
+//! wait for the next client
+static conn_t accept_client(int listener, crocket_shm_transport_t* shm) {
+    conn_t c;
+    c.fd = -1;
+    c.shm = shm;
+    if (shm) {
+        shm_new_session(shm);
+        while (!shm->client_attached) { usleep(1000); }
+        MEMORY_BARRIER();
+    }
+    else {
+        while ((c.fd = accept(listener, NULL, NULL)) < 0) { usleep(1000); }
+    }
+    return c;
+}
+
+//! check whether a client on a shared memory segment is still attached
+#define shm_client_alive(c) ((c)->shm->client_attached)
+
+//! wait until data can be read from a connection
+//! \returns > 0 if data is available, 0 on timeout, < 0 on error
+static int conn_poll(const conn_t* c, int timeout_usec) {
+    if (c->fd >= 0) {
+        struct timeval tv;
+        fd_set fds;
+        tv.tv_sec = 0;
+        tv.tv_usec = timeout_usec;
+        FD_ZERO(&fds);
+        FD_SET(c->fd, &fds);
+        return select(c->fd + 1, &fds, NULL, NULL, &tv);
+    }
+    for (;;) {
+        if (!shm_client_alive(c)) { return -1; }
+        if (c->shm->to_server.head != c->shm->to_server.tail) { return 1; }
+        if (timeout_usec <= 0) { return 0; }
+        usleep(100);
+        timeout_usec -= 100;
+    }
+}
+
+//! receive some data from a connection (blocking)
+//! \returns number of bytes received, or <= 0 on error
+static int conn_recv_some(const conn_t* c, void* data, int bytes) {
+    if (c->fd >= 0) { return (int)recv(c->fd, data, bytes, 0); }
+    while (shm_client_alive(c)) {
+        int res = crocket_ring_read(&c->shm->to_server, data, bytes);
+        if (res > 0) { return res; }
+        usleep(100);
+    }
+    return -1;
+}
+
+//! receive exactly the specified amount of data from a connection
+static int conn_recv(const conn_t* c, void* data, int bytes) {
+    char* pos = data;
+    while (bytes > 0) {
+        int res = conn_recv_some(c, pos, bytes);
+        if (res <= 0) { return 0; }
+        pos += res;
+        bytes -= res;
+    }
+    return 1;
+}
+
+//! send all data into a connection
+static int conn_send(const conn_t* c, const void* data, int bytes) {
+    const char* pos = data;
+    while (bytes > 0) {
+        int res;
+        if (c->fd >= 0) {
+            res = (int)send(c->fd, pos, bytes, MSG_NOSIGNAL);
+        }
+        else {
+            if (!shm_client_alive(c)) { return 0; }
+            res = crocket_ring_write(&c->shm->to_client, pos, bytes);
+            if (!res) { usleep(100); continue; }
+        }
+        if (res <= 0) { return 0; }
+        pos += res;
+        bytes -= res;
+    }
+    return 1;
+}
+
+static void conn_close(conn_t* c) {
+    if (c->fd >= 0) { close(c->fd); }
+    c->fd = -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///// SERVER MODES                                                        /////
+///////////////////////////////////////////////////////////////////////////////
+
+//! send SET_KEY messages for all keys of a track
+static int send_keys(const conn_t* c, unsigned int track_index, const crocket_track_t* t) {
+    unsigned int i;
+    for (i = 0;  t->name && (i < t->nkeys);  ++i) {
+        #pragma pack(push, 1)
+        struct _set_key_cmd {
+            unsigned char cmd;
+            unsigned int track_index;
+            unsigned int row;
+            union _val { unsigned int i; float f; } value;
+            unsigned char interpol;
+        } k;
+        #pragma pack(pop)
+        k.cmd = 0;  // SET_KEY
+        k.track_index = htonl(track_index);
+        k.row = htonl(crocket_key_row(&t->keys[i]));
+        k.value.f = t->keys[i].value;
+        k.value.i = htonl(k.value.i);
+        k.interpol = (unsigned char)crocket_key_interpol(&t->keys[i]);
+        if (!conn_send(c, &k, 14)) { return 0; }
+    }
+    return 1;
+}
+
+//! stand-in editor: answer GET_TRACK with the keys from the CTF file,
+//! and GET_TRACK_HASHED only if the client's keys differ
+static void serve_tracks(const conn_t* c, crocket_track_t* tracks) {
+    unsigned int next_index = 0;
+    char greet[19];
+    // SERVER_GREET, directly followed by HASH_SYNC to announce the extension
+    if (!conn_recv(c, greet, 19) || memcmp(greet, "hello, synctracker!", 19)
+    ||  !conn_send(c, "hello, demo!\x07", 13)) {
+        fprintf(stderr, "client sent an invalid greeting\n");
+        return;
+    }
+    printf("client connected\n");
+    for (;;) {
+        unsigned char cmd;
+        if (!conn_recv(c, &cmd, 1)) { break; }
+        if ((cmd == 2) || (cmd == 7)) {  // GET_TRACK or GET_TRACK_HASHED
+            crocket_track_t* t;
+            char name[1024];
+            unsigned int len, hash = 0;
+            if (!conn_recv(c, &len, 4)) { break; }
+            len = ntohl(len);
+            if ((len >= sizeof(name)) || !conn_recv(c, name, (int)len)) { break; }
+            name[len] = '\0';
+            if ((cmd == 7) && !conn_recv(c, &hash, 4)) { break; }
+            for (t = tracks;  t->name && strcmp(t->name, name);  ++t);
+            if ((cmd == 7) && (ntohl(hash) == (t->name ? crocket_track_hash(t) : 0))) {
+                if (verbose) { printf("track %u: %s (unchanged)\n", next_index, name); }
+            }
+            else {
+                if (cmd == 7) {
+                    #pragma pack(push, 1)
+                    struct _clear_track_cmd {
+                        unsigned char cmd;
+                        unsigned int track_index;
+                    } ct;
+                    #pragma pack(pop)
+                    ct.cmd = 8;  // CLEAR_TRACK
+                    ct.track_index = htonl(next_index);
+                    if (!conn_send(c, &ct, 5)) { break; }
+                }
+                if (!send_keys(c, next_index, t)) { break; }
+                if (verbose) { printf("track %u: %s (%u keys)\n", next_index, name, t->name ? t->nkeys : 0); }
+            }
+            ++next_index;
+        }
+        else if (cmd == 3) {  // SET_ROW
+            unsigned int row;
+            if (!conn_recv(c, &row, 4)) { break; }
+            if (verbose) { printf("row %u\n", ntohl(row)); }
+        }
+        else {
+            fprintf(stderr, "client sent unknown command %d\n", cmd);
+            break;
+        }
+    }
+    printf("client disconnected\n");
+}
+
+//! proxy: forward all data between the client and the upstream editor
+static void forward(const conn_t* c, const char* upstream_spec) {
+    conn_t up;
+    char buf[4096];
+    up.shm = NULL;
+    up.fd = net_connect(upstream_spec);
+    if (up.fd < 0) {
+        fprintf(stderr, "could not connect to editor at '%s'\n", upstream_spec);
+        return;
+    }
+    printf("client connected, forwarding to %s\n", upstream_spec);
+    for (;;) {
+        int moved = 0, res;
+        res = conn_poll(c, 0);
+        if (res < 0) { break; }
+        if (res > 0) {
+            res = conn_recv_some(c, buf, sizeof(buf));
+            if ((res <= 0) || !conn_send(&up, buf, res)) { break; }
+            moved = 1;
+        }
+        res = conn_poll(&up, moved ? 0 : 1000);
+        if (res < 0) { break; }
+        if (res > 0) {
+            res = conn_recv_some(&up, buf, sizeof(buf));
+            if ((res <= 0) || !conn_send(c, buf, res)) { break; }
+        }
+    }
+    conn_close(&up);
+    printf("client disconnected\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char *listen_spec = "tcp:1338", *ctf_file = NULL, *upstream = NULL;
+    crocket_track_t* tracks = NULL;
+    crocket_shm_transport_t* shm;
+    int listener, i;
+
+    // parse command line
+    for (i = 1;  i < argc;  ++i) {
+        const char* arg = argv[i];
+        if ((arg[0] == '-') && arg[1] && !arg[2]) {
+            const char* param = NULL;
+            if (strchr("lfp", arg[1])) {
+                if (++i >= argc) { usage(); return 2; }
+                param = argv[i];
+            }
+            switch (arg[1]) {
+                case 'l': listen_spec = param; break;
+                case 'f': ctf_file = param; break;
+                case 'p': upstream = param; break;
+                case 'v': verbose = 1; break;
+                default: usage(); return 2;
+            }
+        }
+        else { usage(); return 2; }
+    }
+    if (!ctf_file == !upstream) { usage(); return 2; }
+
+    // load tracks
+    if (ctf_file) {
+        void* data = read_file(ctf_file, NULL);
+        tracks = data ? crocket_load_tracks(data) : NULL;
+        free(data);
+        if (!tracks) {
+            fprintf(stderr, "error: could not load CTF file '%s'\n", ctf_file);
+            return 1;
+        }
+    }
+
+    // set up listener
+    atexit(cleanup);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IONBF, 0);
+    listener = create_listener(listen_spec, &shm);
+    printf("listening on %s\n", listen_spec);
+
+    // serve one client at a time, forever
+    for (;;) {
+        conn_t c = accept_client(listener, shm);
+        if (tracks) { serve_tracks(&c, tracks); }
+        else        { forward(&c, upstream); }
+        conn_close(&c);
+    }
+}
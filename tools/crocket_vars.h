@@ -0,0 +1 @@
+// the tools operate on standalone track lists only, no registered tracks
@@ -0,0 +1,91 @@
+//! \file ctfexport.c
+//! \brief exports CTF track data as a table of per-frame values
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crocket.h"
+#include "tool_util.h"
+
+static void usage(void) {
+    printf("Usage: ctfexport [OPTIONS] INPUT.ctf OUTPUT.tab\n"
+           "Options:\n"
+           "  -r RPM      speed of the production in rows per minute (default: 60,\n"
+           "              i.e. all times are specified in rows)\n"
+           "  -f FPS      frame rate of the table (default: 60)\n"
+           "  -s START    time of the first frame, in seconds (default: 0)\n"
+           "  -e END      end of the time range, in seconds (default: last key)\n"
+           "  -c          store the table in column-major order (i.e. track by track)\n"
+           "  -j THREADS  number of threads to use (default: one per CPU core)\n");
+}
+
+int main(int argc, char* argv[]) {
+    int layout = CROCKET_TABLE_ROW_MAJOR, threads = 0, i, size;
+    float rpm = CROCKET_TIME_IN_ROWS, fps = 60.0f, start = 0.0f, end = -1.0f;
+    const char *infile = NULL, *outfile = NULL;
+    crocket_track_t *tracks, *t;
+    crocket_value_table_t* table;
+    void* data;
+
+    // parse command line
+    for (i = 1;  i < argc;  ++i) {
+        const char* arg = argv[i];
+        if ((arg[0] == '-') && arg[1] && !arg[2]) {
+            const char* param = NULL;
+            if (strchr("rfsej", arg[1])) {
+                if (++i >= argc) { usage(); return 2; }
+                param = argv[i];
+            }
+            switch (arg[1]) {
+                case 'r': rpm = (float)atof(param); break;
+                case 'f': fps = (float)atof(param); break;
+                case 's': start = (float)atof(param); break;
+                case 'e': end = (float)atof(param); break;
+                case 'c': layout = CROCKET_TABLE_COLUMN_MAJOR; break;
+                case 'j': threads = atoi(param); break;
+                default: usage(); return 2;
+            }
+        }
+        else if (!infile)  { infile = arg; }
+        else if (!outfile) { outfile = arg; }
+        else { usage(); return 2; }
+    }
+    if (!outfile || !(rpm > 0.0f) || !(fps > 0.0f)) { usage(); return 2; }
+
+    // load input file
+    data = read_file(infile, NULL);
+    tracks = data ? crocket_load_tracks(data) : NULL;
+    free(data);
+    if (!tracks) {
+        fprintf(stderr, "error: could not load CTF file '%s'\n", infile);
+        return 1;
+    }
+
+    // default end time: one frame after the last key
+    if (end < 0.0f) {
+        unsigned int last_row = 0;
+        for (t = tracks;  t->name;  ++t) {
+            if (t->nkeys && (crocket_key_row(&t->keys[t->nkeys - 1]) > last_row)) {
+                last_row = crocket_key_row(&t->keys[t->nkeys - 1]);
+            }
+        }
+        end = (float)last_row * 60.0f / rpm + 1.0f / fps;
+    }
+
+    // produce and write the table
+    table = crocket_make_value_table(tracks, rpm / 60.0f, fps, start, end, layout, threads, &size);
+    crocket_free_tracks(tracks);
+    if (!table) {
+        fprintf(stderr, "error: could not generate value table (empty time range?)\n");
+        return 1;
+    }
+    if (!write_file(outfile, table, size)) {
+        fprintf(stderr, "error: could not write output file '%s'\n", outfile);
+        free(table);
+        return 1;
+    }
+    printf("%u frames x %u tracks, %d bytes written\n", table->nframes, table->ntracks, size);
+    free(table);
+    return 0;
+}
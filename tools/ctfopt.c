@@ -0,0 +1,115 @@
+//! \file ctfopt.c
+//! \brief CTF optimizer: removes redundant keys and quantizes values
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crocket.h"
+#include "tool_util.h"
+
+#define MAX_PRECISION_RULES 64
+
+//! per-track precision setting, selected by track name prefix
+typedef struct _precision_rule {
+    const char* prefix;
+    size_t prefix_len;
+    float precision;
+} precision_rule_t;
+
+static void usage(void) {
+    printf("Usage: ctfopt [OPTIONS] INPUT.ctf OUTPUT.ctf\n"
+           "Options:\n"
+           "  -t TOL          maximum deviation of the optimized curves (default: 0.0001)\n"
+           "  -q STEP         quantize all values to multiples of STEP\n"
+           "  -p PREFIX=STEP  quantize values of tracks whose name starts with PREFIX\n"
+           "                  (overrides -q; the longest matching prefix wins)\n"
+           "  -z              write compressed CTF\n"
+           "  -Z STEP         write compressed CTF, quantized to multiples of STEP\n"
+           "  -v              print statistics for each track\n");
+}
+
+int main(int argc, char* argv[]) {
+    precision_rule_t rules[MAX_PRECISION_RULES];
+    int nrules = 0, format = CROCKET_CTF_PLAIN, verbose = 0, i, size;
+    float tolerance = 0.0001f, precision = 0.0f, ctf_precision = 0.0f;
+    const char *infile = NULL, *outfile = NULL;
+    unsigned int keys_before = 0, keys_after = 0;
+    crocket_track_t *tracks, *t;
+    void* data;
+
+    // parse command line
+    for (i = 1;  i < argc;  ++i) {
+        const char* arg = argv[i];
+        if ((arg[0] == '-') && arg[1] && !arg[2]) {
+            const char* param = NULL;
+            if (strchr("tqpZ", arg[1])) {
+                if (++i >= argc) { usage(); return 2; }
+                param = argv[i];
+            }
+            switch (arg[1]) {
+                case 't': tolerance = (float)atof(param); break;
+                case 'q': precision = (float)atof(param); break;
+                case 'p': {
+                    const char* eq = strchr(param, '=');
+                    if (!eq || (nrules >= MAX_PRECISION_RULES)) { usage(); return 2; }
+                    rules[nrules].prefix = param;
+                    rules[nrules].prefix_len = eq - param;
+                    rules[nrules].precision = (float)atof(eq + 1);
+                    ++nrules;
+                    break; }
+                case 'z': format = CROCKET_CTF_COMPRESSED; break;
+                case 'Z': format = CROCKET_CTF_COMPRESSED; ctf_precision = (float)atof(param); break;
+                case 'v': verbose = 1; break;
+                default: usage(); return 2;
+            }
+        }
+        else if (!infile)  { infile = arg; }
+        else if (!outfile) { outfile = arg; }
+        else { usage(); return 2; }
+    }
+    if (!outfile) { usage(); return 2; }
+
+    // load input file
+    data = read_file(infile, NULL);
+    tracks = data ? crocket_load_tracks(data) : NULL;
+    free(data);
+    if (!tracks) {
+        fprintf(stderr, "error: could not load CTF file '%s'\n", infile);
+        return 1;
+    }
+
+    // optimize tracks
+    for (t = tracks;  t->name;  ++t) {
+        unsigned int nkeys = t->nkeys;
+        float track_precision = precision;
+        size_t best_len = 0;
+        int r;
+        for (r = 0;  r < nrules;  ++r) {
+            if ((rules[r].prefix_len >= best_len)
+            &&  !strncmp(t->name, rules[r].prefix, rules[r].prefix_len)) {
+                track_precision = rules[r].precision;
+                best_len = rules[r].prefix_len;
+            }
+        }
+        crocket_optimize_track(t, tolerance, track_precision);
+        keys_before += nkeys;
+        keys_after += t->nkeys;
+        if (verbose) {
+            printf("%6u -> %6u keys  %s\n", nkeys, t->nkeys, t->name);
+        }
+    }
+
+    // write output file
+    crocket_set_ctf_format(format, ctf_precision);
+    data = crocket_save_tracks(tracks, &size);
+    crocket_free_tracks(tracks);
+    if (!write_file(outfile, data, size)) {
+        fprintf(stderr, "error: could not write output file '%s'\n", outfile);
+        free(data);
+        return 1;
+    }
+    free(data);
+    printf("%u -> %u keys, %d bytes written\n", keys_before, keys_after, size);
+    return 0;
+}
@@ -0,0 +1,83 @@
+//! \file net_util.h
+//! \brief socket helper functions shared by the (POSIX-only) network tools
+
+#ifndef _NET_UTIL_H_
+#define _NET_UTIL_H_
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! create a listening stream socket
+//! \param spec  "tcp:PORT", "PORT" or "unix:PATH"; an existing socket file
+//!              at PATH is removed first
+//! \returns the socket, or -1 on error
+static inline int net_listen(const char* spec) {
+    int fd;
+    if (!strncmp(spec, "unix:", 5)) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, &spec[5], sizeof(addr.sun_path) - 1);
+        unlink(addr.sun_path);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if ((fd >= 0) && bind(fd, (const struct sockaddr*)&addr, sizeof(addr))) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    else {
+        struct sockaddr_in addr;
+        int one = 1;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons((unsigned short)atoi(strncmp(spec, "tcp:", 4) ? spec : &spec[4]));
+        fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (fd >= 0) { setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (void*)&one, sizeof(one)); }
+        if ((fd >= 0) && bind(fd, (const struct sockaddr*)&addr, sizeof(addr))) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if ((fd >= 0) && listen(fd, 16)) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+//! connect to a TCP server
+//! \param spec  "HOST[:PORT]" (default port: 1338)
+//! \returns the socket, or -1 on error
+static inline int net_connect(const char* spec) {
+    struct addrinfo hints, *res = NULL;
+    char host[256];
+    char *port;
+    int fd = -1;
+    strncpy(host, spec, sizeof(host) - 1);
+    host[sizeof(host) - 1] = '\0';
+    port = strchr(host, ':');
+    if (port) { *port++ = '\0'; }
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port ? port : "1338", &hints, &res) || !res) { return -1; }
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if ((fd >= 0) && connect(fd, res->ai_addr, res->ai_addrlen)) {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+#endif // _NET_UTIL_H_
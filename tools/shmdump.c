@@ -0,0 +1,96 @@
+//! \file shmdump.c
+//! \brief reference reader for the shared memory segment of crocket_publish()
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #define MEMORY_BARRIER() MemoryBarrier()
+#else
+    #define _DEFAULT_SOURCE
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #define MEMORY_BARRIER() __sync_synchronize()
+    #define Sleep(ms) usleep((ms) * 1000)
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crocket.h"
+
+//! map a shared memory segment read-only
+static const crocket_shared_values_t* map_segment(const char* name) {
+#ifdef _WIN32
+    HANDLE h = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    return h ? MapViewOfFile(h, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+    struct stat st;
+    void* mem;
+    char path[256];
+    int fd;
+    snprintf(path, sizeof(path), "%s%s", (name[0] == '/') ? "" : "/", name);
+    fd = shm_open(path, O_RDONLY, 0);
+    if (fd < 0) { return NULL; }
+    if (fstat(fd, &st) || ((size_t)st.st_size < sizeof(crocket_shared_values_t))) {
+        close(fd);
+        return NULL;
+    }
+    mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return (mem == MAP_FAILED) ? NULL : mem;
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    const crocket_shared_values_t* sh;
+    const crocket_shared_track_t* dir;
+    float* values;
+    unsigned int i, seq;
+    int state, once = (argc > 2) && !strcmp(argv[2], "-1");
+    float row;
+
+    if (argc < 2) {
+        printf("Usage: shmdump NAME [-1]\n"
+               "Prints the values published by crocket_publish(NAME) continuously,\n"
+               "or only once if -1 is specified.\n");
+        return 2;
+    }
+    sh = map_segment(argv[1]);
+    if (!sh || memcmp(sh->signature, CROCKET_SHARED_VALUES_SIGNATURE, 8)
+    || (sh->version != CROCKET_SHARED_VALUES_VERSION)) {
+        fprintf(stderr, "error: could not open shared memory segment '%s'\n", argv[1]);
+        return 1;
+    }
+    dir = (const crocket_shared_track_t*)((const char*)sh + sh->directory_offset);
+    values = malloc(sh->ntracks * sizeof(float) + 1);
+    if (!values) { return 1; }
+
+    for (;;) {
+        // take a consistent snapshot (seqlock protocol)
+        do {
+            while ((seq = sh->sequence) & 1) {}
+            MEMORY_BARRIER();
+            state = sh->state;
+            row = sh->row;
+            for (i = 0;  i < sh->ntracks;  ++i) {
+                values[i] = *(const float*)((const char*)sh + dir[i].value_offset);
+            }
+            MEMORY_BARRIER();
+        } while (sh->sequence != seq);
+
+        // print it
+        printf("row %.2f %s%s\n", row,
+            (state & CROCKET_STATE_PLAYING) ? "playing" : "paused",
+            (state & CROCKET_STATE_CONNECTED) ? " connected" : "");
+        for (i = 0;  i < sh->ntracks;  ++i) {
+            printf("  %-32s %g\n", (const char*)sh + dir[i].name_offset, values[i]);
+        }
+        if (once) { break; }
+        Sleep(500);
+    }
+    free(values);
+    return 0;
+}
@@ -0,0 +1,40 @@
+//! \file tool_util.h
+//! \brief helper functions shared by the command-line tools
+
+#ifndef _TOOL_UTIL_H_
+#define _TOOL_UTIL_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//! load a whole file into memory
+//! \returns the file's contents, to be free()'d by the caller,
+//!          or NULL if the file could not be read
+static inline void* read_file(const char* filename, long *p_size) {
+    void* data = NULL;
+    long size;
+    FILE *f = fopen(filename, "rb");
+    if (!f) { return NULL; }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size > 0) { data = malloc(size); }
+    if (data && (fread(data, 1, size, f) != (size_t)size)) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    if (p_size) { *p_size = data ? size : 0; }
+    return data;
+}
+
+//! write a block of memory into a file
+//! \returns nonzero if successful
+static inline int write_file(const char* filename, const void* data, long size) {
+    FILE *f = data ? fopen(filename, "wb") : NULL;
+    int ok = f && (fwrite(data, 1, size, f) == (size_t)size);
+    if (f && fclose(f)) { ok = 0; }
+    return ok;
+}
+
+#endif // _TOOL_UTIL_H_